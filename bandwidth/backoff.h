@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+#include "queue_hooks.h"
+
+// Waiting after a failed CAS in gqueue's retry loops, selected at run
+// time. Exponential spins a random number of pauses below a limit that
+// doubles with every failure of the same operation. Proportional spins
+// a random number of pauses below a limit proportional to the failure
+// rate this thread has seen recently, so it waits longer the more
+// contended the line has been, not the longer this operation took.
+namespace bandwidth
+{
+  enum class Backoff : uint32_t { None, Exponential, Proportional };
+
+  inline Backoff g_backoff = Backoff::None;
+  // most pauses of one wait
+  inline uint32_t g_backoffMax = 1024;
+
+  // Exchange slots of gqueue's elimination array, 0 off
+  inline uint32_t g_eliminationSlots = 0;
+
+  // xorshift32, per thread
+  inline uint32_t backoffRandom()
+  {
+    thread_local uint32_t x = 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+  }
+
+  inline void spin(uint32_t pauses)
+  {
+    for (uint32_t i = 0; i < pauses; ++i)
+      __builtin_ia32_pause();
+    count(QueueCounters::BackoffPauses, pauses);
+  }
+
+  // One operation's retry loop
+  class BackoffState
+  {
+  public:
+    void failed()
+    {
+      switch (g_backoff)
+      {
+        case Backoff::None:
+          return;
+
+        case Backoff::Exponential:
+          spin(backoffRandom() % limit_);
+          if (limit_ < g_backoffMax)
+            limit_ *= 2;
+          return;
+
+        case Backoff::Proportional:
+          t_contention += (Scale - t_contention) / Smoothing;
+          spin(backoffRandom() % 
+              (static_cast<uint64_t>(t_contention) * g_backoffMax / Scale + 1));
+          return;
+      }
+    }
+
+    void succeeded()
+    {
+      if (g_backoff == Backoff::Proportional)
+        t_contention -= t_contention / Smoothing;
+    }
+
+  private:
+    // failures per CAS of this thread, a moving average over about
+    // Smoothing CAS, in 1 / Scale
+    static constexpr uint32_t Scale = 1 << 16;
+    static constexpr uint32_t Smoothing = 8;
+    inline static thread_local uint32_t t_contention = 0;
+
+    uint32_t limit_{2};
+  };
+}
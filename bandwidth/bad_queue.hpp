@@ -13,6 +13,7 @@
 
 #include <boost/assert.hpp>
 #include <boost/static_assert.hpp>
+#include <boost/core/allocator_access.hpp>
 #include <boost/type_traits/has_trivial_assign.hpp>
 #include <boost/type_traits/has_trivial_destructor.hpp>
 #include <boost/config.hpp> // for BOOST_LIKELY & BOOST_ALIGNMENT
@@ -27,6 +28,8 @@
 
 #include <iostream>
 
+#include "queue_hooks.h"
+
 #ifdef BOOST_HAS_PRAGMA_ONCE
 #pragma once
 #endif
@@ -134,6 +137,8 @@ private:
     typedef typename pool_t::tagged_node_handle tagged_node_handle;
     typedef typename detail::select_tagged_handle<node, node_based>::handle_type handle_type;
 
+    typedef ::bandwidth::QueueCounters counters;
+
     void initialize(void)
     {
 		std::cout << "Size of node::T "<< sizeof(T) << ", " << alignof(T) << " " << 
@@ -157,6 +162,8 @@ private:
 
 public:
     typedef T value_type;
+
+    static const size_t node_bytes = sizeof(node);
     typedef typename implementation_defined::allocator allocator;
     typedef typename implementation_defined::size_type size_type;
 
@@ -185,7 +192,7 @@ public:
     }
 
     template <typename U>
-    explicit bad_queue(typename node_allocator::template rebind<U>::other const & alloc):
+    explicit bad_queue(typename boost::allocator_rebind<node_allocator, U>::type const & alloc):
         head_(tagged_node_handle(0, 0)),
         tail_(tagged_node_handle(0, 0)),
         pool(alloc, capacity)
@@ -216,7 +223,7 @@ public:
     }
 
     template <typename U>
-    bad_queue(size_type n, typename node_allocator::template rebind<U>::other const & alloc):
+    bad_queue(size_type n, typename boost::allocator_rebind<node_allocator, U>::type const & alloc):
         head_(tagged_node_handle(0, 0)),
         tail_(tagged_node_handle(0, 0)),
         pool(alloc, n + 1)
@@ -297,8 +304,10 @@ private:
         node * n = pool.template construct<true, Bounded>(t, pool.null_handle());
         handle_type node_handle = pool.get_handle(n);
 
-        if (n == NULL)
+        if (n == NULL) {
+            ::bandwidth::count(counters::FailedPushes);
             return false;
+        }
 
         for (;;) {
             tagged_node_handle tail = tail_.load(memory_order_acquire);
@@ -310,15 +319,18 @@ private:
             if (BOOST_LIKELY(tail == tail2)) {
                 if (next_ptr == 0) {
                     tagged_node_handle new_tail_next(node_handle, next.get_next_tag());
-                    if ( tail_node->next.compare_exchange_weak(next, new_tail_next) ) {
+                    if (::bandwidth::countCas(counters::TailCas,
+                                tail_node->next.compare_exchange_weak(next, new_tail_next))) {
                         tagged_node_handle new_tail(node_handle, tail.get_next_tag());
-                        tail_.compare_exchange_strong(tail, new_tail);
+                        ::bandwidth::countCas(counters::TailCas,
+                                tail_.compare_exchange_strong(tail, new_tail));
                         return true;
                     }
                 }
                 else {
                     tagged_node_handle new_tail(pool.get_handle(next_ptr), tail.get_next_tag());
-                    tail_.compare_exchange_strong(tail, new_tail);
+                    ::bandwidth::countCas(counters::TailCas,
+                            tail_.compare_exchange_strong(tail, new_tail));
                 }
             }
         }
@@ -392,11 +404,14 @@ public:
             tagged_node_handle head2 = head_.load(memory_order_acquire);
             if (BOOST_LIKELY(head == head2)) {
                 if (pool.get_handle(head) == pool.get_handle(tail)) {
-                    if (next_ptr == 0)
+                    if (next_ptr == 0) {
+                        ::bandwidth::count(counters::EmptyPops);
                         return false;
+                    }
 
                     tagged_node_handle new_tail(pool.get_handle(next), tail.get_next_tag());
-                    tail_.compare_exchange_strong(tail, new_tail);
+                    ::bandwidth::countCas(counters::TailCas,
+                            tail_.compare_exchange_strong(tail, new_tail));
 
                 } else {
                     if (next_ptr == 0)
@@ -409,7 +424,8 @@ public:
                     detail::copy_payload(next_ptr->data, ret);
 
                     tagged_node_handle new_head(pool.get_handle(next), head.get_next_tag());
-                    if (head_.compare_exchange_weak(head, new_head)) {
+                    if (::bandwidth::countCas(counters::HeadCas,
+                                head_.compare_exchange_weak(head, new_head))) {
                         pool.template destruct<true>(head);
                         return true;
                     }
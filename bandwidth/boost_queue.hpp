@@ -11,8 +11,12 @@
 #ifndef BOOST_GLOCKFREE_FIFO_HPP_INCLUDED
 #define BOOST_GLOCKFREE_FIFO_HPP_INCLUDED
 
+#include <algorithm>
+#include <new>
+
 #include <boost/assert.hpp>
 #include <boost/static_assert.hpp>
+#include <boost/core/allocator_access.hpp>
 #include <boost/type_traits/has_trivial_assign.hpp>
 #include <boost/type_traits/has_trivial_destructor.hpp>
 #include <boost/config.hpp> // for BOOST_LIKELY & BOOST_ALIGNMENT
@@ -25,6 +29,9 @@
 
 #include <boost/lockfree/lockfree_forward.hpp>
 
+#include "backoff.h"
+#include "queue_hooks.h"
+
 #ifdef BOOST_HAS_PRAGMA_ONCE
 #pragma once
 #endif
@@ -133,12 +140,20 @@ private:
     typedef typename pool_t::tagged_node_handle tagged_node_handle;
     typedef typename detail::select_tagged_handle<node, node_based>::handle_type handle_type;
 
+    typedef ::bandwidth::QueueCounters counters;
+
     void initialize(void)
     {
         node * n = pool.template construct<true, false>(pool.null_handle());
         tagged_node_handle dummy_node(pool.get_handle(n), 0);
         head_.store(dummy_node, memory_order_relaxed);
         tail_.store(dummy_node, memory_order_release);
+
+        // the reserve moves to the counted freelist
+        if constexpr (node_based) {
+            while (node * r = pool.template construct<false, true>(pool.null_handle()))
+                depot_push(&r, 1);
+        }
     }
 
     struct implementation_defined
@@ -154,6 +169,8 @@ private:
 
 public:
     typedef T value_type;
+
+    static const size_t node_bytes = sizeof(node);
     typedef typename implementation_defined::allocator allocator;
     typedef typename implementation_defined::size_type size_type;
 
@@ -170,6 +187,19 @@ public:
         return head_.is_lock_free() && tail_.is_lock_free() && pool.is_lock_free();
     }
 
+    //! Calls f(begin, bytes) for each node outside the queue object: the
+    //! dummy and the freelist, so every node before the first push. With
+    //! capacity<> the nodes are part of the object.
+    template <typename F>
+    void for_each_node_block(F && f) const
+    {
+        if constexpr (node_based) {
+            f(pool.get_pointer(head_.load(memory_order_acquire)), sizeof(node));
+            for (node * n = depot_.load(memory_order_acquire).get_ptr(); n; n = link(n))
+                f(n, sizeof(node));
+        }
+    }
+
     //! Construct queue
     // @{
     gqueue(void):
@@ -182,7 +212,7 @@ public:
     }
 
     template <typename U>
-    explicit gqueue(typename node_allocator::template rebind<U>::other const & alloc):
+    explicit gqueue(typename boost::allocator_rebind<node_allocator, U>::type const & alloc):
         head_(tagged_node_handle(0, 0)),
         tail_(tagged_node_handle(0, 0)),
         pool(alloc, capacity)
@@ -213,7 +243,7 @@ public:
     }
 
     template <typename U>
-    gqueue(size_type n, typename node_allocator::template rebind<U>::other const & alloc):
+    gqueue(size_type n, typename boost::allocator_rebind<node_allocator, U>::type const & alloc):
         head_(tagged_node_handle(0, 0)),
         tail_(tagged_node_handle(0, 0)),
         pool(alloc, n + 1)
@@ -246,6 +276,24 @@ public:
         {}
 
         pool.template destruct<false>(head_.load(memory_order_relaxed));
+
+        // node caches of other threads were flushed when they exited
+        if constexpr (node_based) {
+            node_cache & c = t_cache;
+            if (c.owner == this) {
+                for (uint32_t i = 0; i < c.count; ++i)
+                    pool.template destruct<false>(c.nodes[i]);
+                c.owner = nullptr;
+                c.count = 0;
+            }
+
+            node * n = depot_.load(memory_order_relaxed).get_ptr();
+            while (n) {
+                node * next = link(n);
+                pool.template destruct<false>(n);
+                n = next;
+            }
+        }
     }
 
     /** Check if the queue is empty
@@ -291,12 +339,16 @@ private:
     template <bool Bounded>
     bool do_push(T const & t)
     {
-        node * n = pool.template construct<true, Bounded>(t, pool.null_handle());
+        node * n = alloc_node<Bounded>(t);
         handle_type node_handle = pool.get_handle(n);
 
-        if (n == NULL)
+        if (n == NULL) {
+            ::bandwidth::count(counters::FailedPushes);
             return false;
+        }
+        ::bandwidth::tagWrite("queue node", n, sizeof(node));
 
+        ::bandwidth::BackoffState backoff;
         for (;;) {
             tagged_node_handle tail = tail_.load(memory_order_acquire);
             node * tail_node = pool.get_pointer(tail);
@@ -307,15 +359,27 @@ private:
             if (BOOST_LIKELY(tail == tail2)) {
                 if (next_ptr == 0) {
                     tagged_node_handle new_tail_next(node_handle, next.get_next_tag());
-                    if ( tail_node->next.compare_exchange_weak(next, new_tail_next) ) {
+                    ::bandwidth::tagWrite("queue node next", &tail_node->next, sizeof(tail_node->next));
+                    if (::bandwidth::countCas(counters::TailCas,
+                                tail_node->next.compare_exchange_weak(next, new_tail_next))) {
                         tagged_node_handle new_tail(node_handle, tail.get_next_tag());
-                        tail_.compare_exchange_strong(tail, new_tail);
+                        ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+                        ::bandwidth::countCas(counters::TailCas,
+                                tail_.compare_exchange_strong(tail, new_tail));
+                        backoff.succeeded();
                         return true;
                     }
+
+                    // a popper waiting on an empty queue takes the node directly
+                    if (::bandwidth::g_eliminationSlots && is_empty(tail) && give(node_handle))
+                        return true;
+                    backoff.failed();
                 }
                 else {
                     tagged_node_handle new_tail(pool.get_handle(next_ptr), tail.get_next_tag());
-                    tail_.compare_exchange_strong(tail, new_tail);
+                    ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+                    ::bandwidth::countCas(counters::TailCas,
+                            tail_.compare_exchange_strong(tail, new_tail));
                 }
             }
         }
@@ -378,6 +442,13 @@ public:
     template <typename U>
     bool pop (U & ret)
     {
+        // an empty queue costs two loads and never touches tail_
+        if (::bandwidth::g_popPeek && !::bandwidth::g_eliminationSlots && peek_empty()) {
+            ::bandwidth::count(counters::EmptyPops);
+            return false;
+        }
+
+        ::bandwidth::BackoffState backoff;
         for (;;) {
             tagged_node_handle head = head_.load(memory_order_acquire);
             node * head_ptr = pool.get_pointer(head);
@@ -389,11 +460,17 @@ public:
             tagged_node_handle head2 = head_.load(memory_order_acquire);
             if (BOOST_LIKELY(head == head2)) {
                 if (pool.get_handle(head) == pool.get_handle(tail)) {
-                    if (next_ptr == 0)
+                    if (next_ptr == 0) {
+                        if (::bandwidth::g_eliminationSlots && take(ret))
+                            return true;
+                        ::bandwidth::count(counters::EmptyPops);
                         return false;
+                    }
 
                     tagged_node_handle new_tail(pool.get_handle(next), tail.get_next_tag());
-                    tail_.compare_exchange_strong(tail, new_tail);
+                    ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+                    ::bandwidth::countCas(counters::TailCas,
+                            tail_.compare_exchange_strong(tail, new_tail));
 
                 } else {
                     if (next_ptr == 0)
@@ -406,10 +483,18 @@ public:
                     detail::copy_payload(next_ptr->data, ret);
 
                     tagged_node_handle new_head(pool.get_handle(next), head.get_next_tag());
-                    if (head_.compare_exchange_weak(head, new_head)) {
-                        pool.template destruct<true>(head);
+                    ::bandwidth::tagWrite("queue head", &head_, sizeof(head_));
+                    if (::bandwidth::countCas(counters::HeadCas,
+                                head_.compare_exchange_weak(head, new_head))) {
+                        // the freelist reuses the node's next field
+                        ::bandwidth::tagWrite("queue node", head_ptr, sizeof(head_ptr->next));
+                        free_node(head);
+                        backoff.succeeded();
+                        if (::bandwidth::g_popPrefetch)
+                            prefetch_next(next_ptr);
                         return true;
                     }
+                    backoff.failed();
                 }
             }
         }
@@ -532,6 +617,245 @@ public:
 
 private:
 #ifndef BOOST_DOXYGEN_INVOKED
+    // Node based queues keep free nodes on their own tagged stack in
+    // front of the pool (which only allocates new ones), so its CAS can
+    // be counted. With ::bandwidth::g_nodeCacheBatch set every thread
+    // also keeps a cache of up to twice the batch, refilled from and
+    // flushed to the stack a batch (one CAS) at a time. Free nodes are
+    // linked through next, like in the pool's freelist.
+    static constexpr uint32_t max_cache_batch = 256;
+
+    struct node_cache
+    {
+        ~node_cache(void)
+        {
+            if (owner && count)
+                owner->depot_push(nodes, count);
+        }
+
+        gqueue * owner{nullptr};
+        uint32_t count{0};
+        node * nodes[2 * max_cache_batch];
+    };
+
+    // one cache per thread, switching to another queue (a lanequeue's
+    // next lane) first hands the nodes back to the queue they came from
+    inline static thread_local node_cache t_cache;
+
+    node_cache & cache(void)
+    {
+        node_cache & c = t_cache;
+        if (c.owner != this) {
+            if (c.owner && c.count) {
+                c.owner->depot_push(c.nodes, c.count);
+                ::bandwidth::count(counters::CacheFlushes);
+            }
+            c.owner = this;
+            c.count = 0;
+        }
+        return c;
+    }
+
+    static uint32_t cache_batch(void)
+    {
+        return (std::min)(::bandwidth::g_nodeCacheBatch, max_cache_batch);
+    }
+
+    static node * link(node * n)
+    {
+        return n->next.load(memory_order_relaxed).get_ptr();
+    }
+
+    static void set_link(node * n, node * to)
+    {
+        tagged_node_handle old = n->next.load(memory_order_relaxed);
+        n->next.store(tagged_node_handle(to, old.get_tag()), memory_order_relaxed);
+    }
+
+    // count nodes as one chain, one CAS
+    void depot_push(node * const * nodes, uint32_t count)
+    {
+        for (uint32_t i = 0; i + 1 < count; ++i)
+            set_link(nodes[i], nodes[i + 1]);
+
+        for (;;) {
+            tagged_node_handle old = depot_.load(memory_order_acquire);
+            set_link(nodes[count - 1], old.get_ptr());
+            ::bandwidth::tagWrite("queue freelist", &depot_, sizeof(depot_));
+            if (::bandwidth::countCas(counters::FreelistCas, depot_.compare_exchange_weak(old,
+                            tagged_node_handle(nodes[0], old.get_next_tag()), memory_order_release)))
+                return;
+        }
+    }
+
+    // up to max nodes, one CAS: an unchanged tagged top means the
+    // chain walked below it was not changed either
+    uint32_t depot_pop(node ** nodes, uint32_t max)
+    {
+        for (;;) {
+            tagged_node_handle old = depot_.load(memory_order_acquire);
+            node * n = old.get_ptr();
+            if (!n)
+                return 0;
+
+            uint32_t k = 0;
+            while (n && k < max) {
+                nodes[k++] = n;
+                n = link(n);
+            }
+
+            ::bandwidth::tagWrite("queue freelist", &depot_, sizeof(depot_));
+            if (::bandwidth::countCas(counters::FreelistCas,
+                        depot_.compare_exchange_weak(old, tagged_node_handle(n, old.get_next_tag()))))
+                return k;
+        }
+    }
+
+    template <bool Bounded>
+    node * alloc_node(T const & t)
+    {
+        if constexpr (node_based) {
+            node * n = nullptr;
+            if (uint32_t batch = cache_batch()) {
+                node_cache & c = cache();
+                if (!c.count) {
+                    c.count = depot_pop(c.nodes, batch);
+                    if (c.count)
+                        ::bandwidth::count(counters::CacheRefills);
+                }
+                if (c.count)
+                    n = c.nodes[--c.count];
+            }
+            else
+                depot_pop(&n, 1);
+
+            if (n) {
+                // the constructor cannot be trusted to keep the tag
+                tagged_node_handle old = n->next.load(memory_order_relaxed);
+                n = new (n) node(t, pool.null_handle());
+                n->next.store(tagged_node_handle(pool.null_handle(), old.get_next_tag()),
+                        memory_order_release);
+                return n;
+            }
+        }
+
+        return pool.template construct<true, Bounded>(t, pool.null_handle());
+    }
+
+    void free_node(tagged_node_handle h)
+    {
+        if constexpr (node_based) {
+            node * n = pool.get_pointer(h);
+            if (uint32_t batch = cache_batch()) {
+                node_cache & c = cache();
+                c.nodes[c.count++] = n;
+                if (c.count >= 2 * batch) {
+                    c.count -= batch;
+                    depot_push(c.nodes + c.count, batch);
+                    ::bandwidth::count(counters::CacheFlushes);
+                }
+            }
+            else
+                depot_push(&n, 1);
+            return;
+        }
+
+        pool.template destruct<true>(h);
+    }
+
+    // Elimination: a push that lost the tail CAS while the queue is
+    // empty may hand its value to a pop that found it empty and waits
+    // in a slot, neither touches head or tail. Only an empty queue, so
+    // FIFO order holds: the pair is a push and pop at that empty point.
+    // The slot passes the push's node, so its size does not depend on T
+    // and the pop frees the node.
+    static constexpr uint32_t max_elimination_slots = 16;
+    static const uint32_t elimination_wait = 128;
+
+    enum slot_state : uint32_t { slot_free, slot_waiting, slot_busy, slot_full };
+
+    struct BOOST_ALIGNMENT(BOOST_LOCKFREE_CACHELINE_BYTES) elimination_slot
+    {
+        atomic<uint32_t> state{slot_free};
+        handle_type node_handle;
+    };
+
+    static uint32_t elimination_slot_index(void)
+    {
+        uint32_t slots = (std::min)(::bandwidth::g_eliminationSlots, max_elimination_slots);
+        return ::bandwidth::backoffRandom() % slots;
+    }
+
+    /* Read only: the dummy node has no successor. A recycled head may
+     * answer either way, the full pop decides, but nothing here pulls
+     * the producers' tail_ line into the consumer's cache. */
+    bool peek_empty(void) const
+    {
+        tagged_node_handle head = head_.load(memory_order_acquire);
+        node const * head_ptr = pool.get_pointer(head);
+        return pool.get_pointer(head_ptr->next.load(memory_order_relaxed)) == 0;
+    }
+
+    /* new_head holds the next message's link: start loading that node,
+     * most likely written by a producer on another core */
+    void prefetch_next(node * new_head) const
+    {
+        node * next_ptr = pool.get_pointer(new_head->next.load(memory_order_relaxed));
+        if (next_ptr)
+            __builtin_prefetch(next_ptr, 0, 3);
+    }
+
+    bool is_empty(tagged_node_handle tail)
+    {
+        return pool.get_handle(head_.load(memory_order_acquire)) == pool.get_handle(tail);
+    }
+
+    bool give(handle_type node_handle)
+    {
+        elimination_slot & s = elimination_[elimination_slot_index()];
+        uint32_t waiting = slot_waiting;
+        if (s.state.load(memory_order_relaxed) != slot_waiting ||
+                !s.state.compare_exchange_strong(waiting, slot_busy, memory_order_acquire))
+            return false;
+
+        ::bandwidth::tagWrite("queue elimination", &s, sizeof(s));
+        s.node_handle = node_handle;
+        s.state.store(slot_full, memory_order_release);
+        ::bandwidth::count(counters::Eliminations);
+        return true;
+    }
+
+    template <typename U>
+    bool take(U & ret)
+    {
+        elimination_slot & s = elimination_[elimination_slot_index()];
+        uint32_t free = slot_free;
+        ::bandwidth::tagWrite("queue elimination", &s.state, sizeof(s.state));
+        if (!s.state.compare_exchange_strong(free, slot_waiting))
+            return false;
+
+        for (uint32_t i = 0; i < elimination_wait; ++i) {
+            if (s.state.load(memory_order_acquire) == slot_full)
+                break;
+            __builtin_ia32_pause();
+        }
+
+        uint32_t waiting = slot_waiting;
+        if (s.state.compare_exchange_strong(waiting, slot_free))
+            return false;
+
+        // a push claimed the slot, wait for its value
+        while (s.state.load(memory_order_acquire) != slot_full)
+            __builtin_ia32_pause();
+
+        handle_type node_handle = s.node_handle;
+        s.state.store(slot_free, memory_order_release);
+        detail::copy_payload(pool.get_pointer(node_handle)->data, ret);
+        free_node(tagged_node_handle(node_handle, 0));
+        ::bandwidth::count(counters::Eliminations);
+        return true;
+    }
+
     atomic<tagged_node_handle> head_;
     static const int padding_size = BOOST_LOCKFREE_CACHELINE_BYTES - sizeof(tagged_node_handle);
     char padding1[padding_size];
@@ -540,6 +864,11 @@ private:
     char padding2[padding_size];
     char padding2a[64];
 
+    atomic<tagged_node_handle> depot_{tagged_node_handle(0, 0)};
+    char padding3[padding_size];
+
+    elimination_slot elimination_[max_elimination_slots];
+
     pool_t pool;
 #endif
 };
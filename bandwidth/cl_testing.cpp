@@ -7,25 +7,171 @@
 #include <memory>
 #include <algorithm>
 #include <set>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <type_traits>
+#include <iomanip>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <cctype>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 
 #include <boost/lexical_cast.hpp>
 #include <boost/lockfree/queue.hpp>
 
 #include "getcc.h"
+#include "backoff.h"
 #include "bad_queue.hpp"
 #include "boost_queue.hpp"
+#include "compact_queue.hpp"
+#include "coro_scheduler.h"
+#include "disruptor.h"
+#include "faa_queue.hpp"
+#include "false_sharing.h"
+#include "fc_queue.hpp"
+#include "footprint.h"
+#include "histogram.h"
+#include "lane_queue.hpp"
+#include "mpsc_queue.hpp"
+#include "perf_counters.h"
+#include "queue_hooks.h"
+#include "rcu.h"
+#include "seqlock.h"
+#include "shared_arena.h"
+#include "sharded_counter.h"
+#include "slab_queue.hpp"
 
 template <int Align>
 int simpleTest(const std::string& pc);
+int atomicSuite(const std::string& pc);
 
 constexpr float     g_CPUGHzSpeed = 3.0;
 
+// Optional trailing <name>=<value> arguments, see usage in main
+struct Options
+{
+  // logical consumers run by each 'm' thread
+  uint32_t coroutines{10};
+
+  // messages pushed by each producer
+  uint32_t messages{1000000000};
+
+  // fixed duration mode when duration > 0, seconds
+  double warmup{1.0};
+  double duration{0.0};
+  uint32_t repeats{1};
+
+  // open loop producers when rate or load is set
+  enum class Arrival { Constant, Poisson, Bursty };
+  Arrival arrival{Arrival::Constant};
+  uint32_t burst{16};
+  // messages/sec per producer
+  double rate{0.0};
+  // fraction of nominal consumer capacity, overrides rate
+  std::vector<double> loads;
+  double load{0.0};
+
+  bool openLoop() const { return rate > 0 || load > 0; }
+
+  // roles forked into processes sharing one memory segment
+  bool processes{false};
+
+  // per thread hardware counters
+  bool perf{false};
+
+  // consumer result writes to per thread shards rather than the
+  // shared wwd atomics, published every flush messages
+  bool shardedWrites{false};
+  uint32_t flush{1};
+
+  // how the worker publishes the read data: in place atomics, a
+  // seqlock consumers copy from in one go, or RCU versions
+  enum class Publish { Atomic, SeqLock, Rcu };
+  Publish publish{Publish::Atomic};
+
+  // table of cache lines written by more than one core
+  FalseSharingDetector::Mode falseSharing{FalseSharingDetector::Mode::Off};
+
+  // share of each producer's messages pushed to each lane of a
+  // lanequeue, empty spreads them evenly over bandwidth::g_lanes
+  std::vector<uint32_t> laneMix;
+
+  // 'c' consumers poll in a tight loop, or adapt to their recent
+  // works/polls ratio: budget messages between yields of the core, 
+  // and when idle longer waits between polls up to a park of
+  // parkMicros
+  bool adaptivePoll{false};
+  uint32_t budget{64};
+  uint32_t parkMicros{50};
+};
+
+Options g_options;
+
 // TODO better namespace name
 namespace Thread
 {
-  std::atomic<bool> g_pstart(false);
-  std::atomic<bool> g_cstart(false);
+  // position in the pc string (the pinned cpu) of this thread
+  thread_local uint32_t t_core{0};
+}
+
+// Shared by all threads of one run. Every thread is created pinned,
+// does its own setup and then arrives at the start barrier, the run 
+// starts the moment the last thread has arrived.
+struct RunControl
+{
+  static constexpr uint32_t MaxThreads = 256;
+
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> go_{false};
+  std::atomic<uint32_t> ready_{0};
+  // TSC of each core's arrival at the barrier
+  std::atomic<uint64_t> readyAt_[MaxThreads];
+  // kernel thread id of each core's role
+  std::atomic<int32_t> tid_[MaxThreads];
+  // queue internals counted by each core's role
+  bandwidth::QueueCounters queue_[MaxThreads];
+
+  bool stopped() { return stop_.load(std::memory_order_relaxed); }
+
+  void arriveAndWait()
+  {
+    tid_[Thread::t_core].store(syscall(SYS_gettid), std::memory_order_relaxed);
+    bandwidth::t_queueCounters = &queue_[Thread::t_core];
+    readyAt_[Thread::t_core].store(getcc_ns(), std::memory_order_relaxed);
+    ready_.fetch_add(1, std::memory_order_release);
+
+    while (!go_.load(std::memory_order_acquire))
+      __builtin_ia32_pause();
+  }
+
+  // returns the TSC the last thread was seen ready at
+  uint64_t waitReady(uint32_t threads)
+  {
+    while (ready_.load(std::memory_order_acquire) < threads)
+      __builtin_ia32_pause();
+
+    return getcc_ns();
+  }
+
+  void release()
+  {
+    go_.store(true, std::memory_order_release);
+  }
+};
+
+// Tag mode false sharing detection, every tagged write goes to the
+// line table of the core it runs on
+FalseSharingDetector* g_falseSharing = nullptr;
+
+void tagFalseSharing(const char* name, const void* addr, size_t size)
+{
+  g_falseSharing->tag(Thread::t_core, name, addr, size);
 }
 
 // [include]
@@ -45,6 +191,21 @@ struct Benchmark
   uint32_t workCycles{0};
 };
 
+// Open loop message, carries the TSC time it was due to be sent
+struct TimedBenchmark : Benchmark
+{
+  uint64_t intended{0};
+};
+
+inline void stamp(Benchmark&, uint64_t) {}
+inline void stamp(TimedBenchmark& b, uint64_t due) { b.intended = due; }
+
+inline void recordLatency(LatencyHistogram&, const Benchmark&) {}
+inline void recordLatency(LatencyHistogram& h, const TimedBenchmark& b)
+{
+  h.record(getcc_ns() - b.intended);
+}
+
 template <typename Bench, int X>
 struct Alignment
 {
@@ -52,56 +213,216 @@ struct Alignment
   Bench& get() { return cb; }
 };
 
-// 1/2 cache line
+// Bench padded to Bytes. The producer fills the padding and the
+// consumer reads it back, so a message costs its whole size.
+template <typename Bench, uint32_t Bytes, 
+         uint32_t Rest = Bytes - sizeof(Bench)>
+struct Payload
+{
+  Bench cb;
+  unsigned char bytes[Rest];
+  Bench& get() { return cb; }
+};
+
+template <typename Bench, uint32_t Bytes>
+struct Payload<Bench, Bytes, 0>
+{
+  Bench cb;
+  Bench& get() { return cb; }
+};
+
+template <typename T>
+void fillPayload(T&) {}
+template <typename Bench, uint32_t Bytes, uint32_t Rest>
+void fillPayload(Payload<Bench, Bytes, Rest>& p)
+{
+  thread_local unsigned char seq{0};
+  if constexpr (Rest > 0)
+    std::memset(p.bytes, ++seq, Rest);
+}
+
+template <typename T>
+void readPayload(const T&) {}
+template <typename Bench, uint32_t Bytes, uint32_t Rest>
+void readPayload(const Payload<Bench, Bytes, Rest>& p)
+{
+  uint64_t sum{0};
+  if constexpr (Rest > 0)
+    for (uint32_t i = 0; i < Rest; ++i)
+      sum += p.bytes[i];
+  asm volatile("" : : "r"(sum));
+}
+
+template <typename T>
+constexpr bool isTimed = std::is_same_v<
+  std::decay_t<decltype(std::declval<T&>().get())>, TimedBenchmark>;
+
+// Compile time layout of the data shared by consumers and the worker
+//  Align: alignment of each block (AoS element), 0 follows alignof(T)
+//  Elems: elements read (rwd) and written (wwd) per work iteration
+//  Pad: bytes between the read and the write data
+//  Slots: 1 all consumers write the same wwd, n each consumer
+//         writes slot core % n and the worker combines them
+//  Interleaved: AoS, the read element and its write slots side by
+//         side, rather than SoA, all reads then all writes
+template <uint32_t Align, uint32_t Elems, uint32_t Pad = 0,
+         uint32_t Slots = 1, bool Interleaved = false>
+struct WorkLayout
+{
+  static constexpr uint32_t align = Align;
+  static constexpr uint32_t elems = Elems;
+  static constexpr uint32_t pad = Pad;
+  static constexpr uint32_t slots = Slots;
+  static constexpr bool interleaved = Interleaved;
+};
+
+// two 1/2 cache lines at the alignment of T
+using DefaultLayout = WorkLayout<0, 8>;
+
+template <uint32_t Bytes>
+struct Padding
+{
+  char bytes[Bytes];
+};
+
+template <>
+struct Padding<0>
+{
+};
+
+template <uint32_t N>
 struct ReadWorkData
 {
-  enum Size : uint32_t { Elem = 8 };
+  enum Size : uint32_t { Elem = N };
   std::atomic<uint32_t> data[Elem];
 };
 
-// 1/2 cache line
+template <uint32_t N>
 struct WriteWorkData
 {
-  enum Size : uint32_t { Elem = 8 };
+  enum Size : uint32_t { Elem = N };
   std::atomic<uint32_t> data[Elem];
 };
 
-template <int X>
+// SoA: rwd, Pad bytes, then the write slots
+template <int X, typename L = DefaultLayout, bool = L::interleaved>
 struct WorkData
 {
-  WorkData() 
-  { 
-    for (uint32_t i=0; i<ReadWorkData::Elem; ++i)
-      rwd.data[i].store(0);
-
-    for (uint32_t i=0; i<WriteWorkData::Elem; ++i)
-      wwd.data[i].store(0);
-  }
+  static constexpr uint32_t Elems = L::elems;
+  static constexpr uint32_t Slots = L::slots;
 
-  WorkData(const WorkData& wd)
+  // alignas on the array would align only its first element, each
+  // slot starts its own X block
+  struct alignas (X) WriteSlot
   {
-    if (&wd == this)
-      return;
+    WriteWorkData<Elems> data{};
+  };
+
+  std::atomic<uint32_t>& read(uint32_t i) { return rwd.data[i]; }
+  std::atomic<uint32_t>& write(uint32_t slot, uint32_t i) { return wwd[slot].data.data[i]; }
 
-    for (uint32_t i=0; i<ReadWorkData::Elem; ++i)
-      rwd.data[i].store(wd.rwd.data[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+  alignas (X) ReadWorkData<Elems> rwd{};
+  [[no_unique_address]] Padding<L::pad> pad;
+  WriteSlot wwd[Slots]{};
+};
+
+// AoS: each read element followed by Pad bytes and its write slots
+template <int X, typename L>
+struct WorkData<X, L, true>
+{
+  static constexpr uint32_t Elems = L::elems;
+  static constexpr uint32_t Slots = L::slots;
+
+  struct alignas (X) Elem
+  {
+    std::atomic<uint32_t> read{0};
+    [[no_unique_address]] Padding<L::pad> pad;
+    std::atomic<uint32_t> write[Slots]{};
   };
 
-  WorkData& operator=(const WorkData& wd)
+  std::atomic<uint32_t>& read(uint32_t i) { return elems[i].read; }
+  std::atomic<uint32_t>& write(uint32_t slot, uint32_t i) { return elems[i].write[slot]; }
+
+  Elem elems[Elems];
+};
+
+// WorkData plus the alternative ways of sharing it: sharded result
+// counters and seqlock or RCU published copies of the read data
+template <typename WD>
+struct WorkState : WD
+{
+  using Counters = ShardedCounters<WD::Elems, RunControl::MaxThreads>;
+  Counters shards;
+
+  SeqLock<WD::Elems> seqlock;
+  RcuPublisher<WD::Elems, 4, RunControl::MaxThreads> rcu;
+
+  // reads, retries of the consumers
+  enum ReadStat : uint32_t { Reads, Retries, ReadStats };
+  using ReadCounters = ShardedCounters<ReadStats, RunControl::MaxThreads>;
+  ReadCounters readStats;
+};
+
+// the calling thread's registration as an RCU reader
+template <typename WD>
+uint32_t rcuReader(WD& wd)
+{
+  thread_local uint32_t reader = wd.rcu.registerReader();
+  return reader;
+}
+
+// A consumer's checkpoint is an RCU quiescent state, it holds no
+// version between messages.
+template <typename WD>
+void quiescent(WD& wd)
+{
+  if (g_options.publish == Options::Publish::Rcu)
+    wd.rcu.quiescent(rcuReader(wd));
+}
+
+// Consumer's private copy of the read data
+template <typename WD>
+struct LocalWorkData
+{
+  explicit LocalWorkData(WD& wd)
   {
-    if (&wd == this)
-      return *this;
+    if (g_options.publish == Options::Publish::Rcu)
+    {
+      thread_local typename WD::ReadCounters::Writer stats(
+          wd.readStats, 1);
+      rcuReader(wd);
+      wd.rcu.read(data);
+      stats.increment(WD::Reads);
+      stats.commit();
+      return;
+    }
 
-    for (uint32_t i=0; i<ReadWorkData::Elem; ++i)
-      wwd.data[i].store(wd.wwd.data[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if (g_options.publish == Options::Publish::SeqLock)
+    {
+      thread_local typename WD::ReadCounters::Writer stats(
+          wd.readStats, 1);
+      uint32_t retries = wd.seqlock.read(data);
+      stats.increment(WD::Reads);
+      for (uint32_t i = 0; i < retries; ++i)
+        stats.increment(WD::Retries);
+      stats.commit();
+      return;
+    }
 
-    return *this;
+    for (uint32_t i = 0; i < WD::Elems; ++i)
+      data[i] = wd.read(i).load(std::memory_order_relaxed);
   }
 
-  alignas (X) ReadWorkData rwd;
-  alignas (X) WriteWorkData wwd;
+  uint32_t data[WD::Elems];
 };
 
+// write slot of the calling consumer
+template <typename WD>
+uint32_t writeSlot()
+{
+  return WD::Slots == 1 ? 0 : Thread::t_core % WD::Slots;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Duty cycle, saturation, testing
 ///////////////////////////////////////////////////////////////////////////////
@@ -285,6 +606,10 @@ struct CycleTracker
 
   void setClear()
   {
+    bandwidth::tagWrite("tracker start/end", &start_, 
+        sizeof(start_) + sizeof(end_));
+    bandwidth::tagWrite("tracker flags", &controlFlags_, 
+        sizeof(controlFlags_));
     start_ = end_ = getcc_ns();
     controlFlags_ |= ControlFlags::Clear;
   }
@@ -297,6 +622,9 @@ struct CycleTracker
 
     ~CheckPoint()
     {
+      bandwidth::tagWrite("tracker", &ct_.end_, 
+          offsetof(CycleTracker, controlFlags_) - offsetof(CycleTracker, end_));
+      bandwidth::tagWrite("results", &rs_, sizeof(rs_));
       ct_.clear();
 
       if (p2_)
@@ -321,11 +649,90 @@ struct CycleTracker
 };
 /////////////////////////////////////////////////
 
+template <typename Q>
+constexpr bool isSlab = false;
+template <typename T, typename... Options>
+constexpr bool isSlab<boost::lockfree::slabqueue<T, Options...>> = true;
+
+// One push attempt of a producer. A poll is an attempt, work a push
+// that succeeded: its duty is the successful push, its overhead a
+// failed one including the pause after it. The payload is written in
+// the attempt, in place for a slab.
+template <typename T, typename Q>
+bool trackedPush(Q* q, T& d, ResultsSync& rs, CycleTracker& ct)
+{
+  CycleTracker::CheckPoint cp(ct, rs);
+  cp.markOne();
+  cp.markTwo();
+  if constexpr (isSlab<Q>)
+  {
+    // only the slot index is queued
+    uint32_t slot = q->claim();
+    if (slot != Q::null_slot)
+    {
+      T& m = q->at(slot);
+      m.get() = d.get();
+      fillPayload(m);
+      q->push_slot(slot);
+      cp.markThree();
+      return true;
+    }
+  }
+  else
+  {
+    fillPayload(d);
+    if (q->push(d))
+    {
+      cp.markThree();
+      return true;
+    }
+  }
+
+  __builtin_ia32_pause();
+  cp.markTwo();
+  return false;
+}
+
+template <typename Q>
+constexpr bool isLaned = false;
+template <typename T, typename... Options>
+constexpr bool isLaned<boost::lockfree::lanequeue<T, Options...>> = true;
+
+// Tags the lane of the producer's next message, smooth weighted round
+// robin over g_options.laneMix so a lane's share is spread out rather
+// than sent in runs
+void nextLane()
+{
+  auto& mix = g_options.laneMix;
+  uint32_t lanes = mix.empty() ? bandwidth::g_lanes 
+    : std::min<uint32_t>(mix.size(), bandwidth::MaxLanes);
+  thread_local int64_t credit[bandwidth::MaxLanes]{};
+
+  int64_t total{0};
+  uint32_t best{0};
+  for (uint32_t l = 0; l < lanes; ++l)
+  {
+    credit[l] += mix.empty() ? 1 : mix[l];
+    total += mix.empty() ? 1 : mix[l];
+    if (credit[l] > credit[best])
+      best = l;
+  }
+  credit[best] -= total;
+  bandwidth::t_pushLane = best;
+}
+
+// Latency of the messages one consumer took from each lane
+struct alignas(64) LaneLatency
+{
+  LatencyHistogram lane[bandwidth::MaxLanes];
+};
+
 // [include]
 template <typename T, typename Q>
-void producer(Q* q, uint32_t iterations, uint64_t workCycles, uint32_t workIterations)
+void producer(Q* q, uint32_t iterations, uint64_t workCycles, uint32_t workIterations,
+    ResultsSync& rs, CycleTracker& ct, RunControl& ctl)
 {
-  while (Thread::g_pstart.load() == false) {}
+  ctl.arriveAndWait();
 
   T d;
 
@@ -334,38 +741,157 @@ void producer(Q* q, uint32_t iterations, uint64_t workCycles, uint32_t workItera
 
   bool work = false;
 
-  for ( uint32_t i = 0; i < iterations; ++i)
+  ct.start();
+  for ( uint32_t i = 0; i < iterations && !ctl.stopped(); ++i)
   {
+    if constexpr (isLaned<Q>)
+      nextLane();
     do 
     { 
-      work = (q->push(d));
-      if(!work)
-        __builtin_ia32_pause();
+      work = trackedPush(q, d, rs, ct);
+    } while (!work && !ctl.stopped()); 
+  }
+}
 
-    } while (!work); 
+// Open loop producer: messages are due on a TSC timeline set by the
+// arrival process, however long push() takes. The due time travels in
+// the message so latency is measured from when it should have been sent,
+// a producer that falls behind does not hide the queueing it caused.
+template <typename T, typename Q>
+void openLoopProducer(Q* q, uint32_t iterations, uint64_t workCycles, uint32_t workIterations,
+    double intervalCycles, uint32_t seed, 
+    ResultsSync& rs, CycleTracker& ct, RunControl& ctl)
+{
+  ctl.arriveAndWait();
+
+  T d;
+
+  d.get().workCycles = workCycles;
+  d.get().workIterations = workIterations;
+
+  std::mt19937_64 rng(seed);
+  std::exponential_distribution<double> exponential(1.0);
+
+  uint32_t burst = g_options.arrival == Options::Arrival::Bursty 
+    ? g_options.burst : 1;
+
+  double due = getcc_ns();
+  bool work = false;
+
+  // the wait for the due time is neither duty nor overhead
+  ct.start();
+  for ( uint32_t i = 0; i < iterations && !ctl.stopped(); ++i)
+  {
+    // a burst shares one due time, the gap keeps the mean rate
+    if (i && i % burst == 0)
+    {
+      if (g_options.arrival == Options::Arrival::Poisson)
+        due += intervalCycles * exponential(rng);
+      else
+        due += intervalCycles * burst;
+    }
+
+    uint64_t dueCycles = static_cast<uint64_t>(due);
+    while (getcc_ns() < dueCycles)
+    {
+      if (ctl.stopped())
+        return;
+      __builtin_ia32_pause();
+    }
+
+    stamp(d.get(), dueCycles);
+    if constexpr (isLaned<Q>)
+      nextLane();
+    do 
+    { 
+      work = trackedPush(q, d, rs, ct);
+    } while (!work && !ctl.stopped()); 
   }
 }
 
 // EX2: Begin
+// the calling thread's own shard, the worker combines them
+template <typename WD>
+typename WD::Counters::Writer& shardWriter(WD& wd)
+{
+  thread_local typename WD::Counters::Writer writer(
+      wd.shards, g_options.flush);
+  return writer;
+}
+
+template <typename T, typename WD>
+void simulateWork(T& d, WD& wd, uint64_t start)
+{
+  // simulate work:
+  // When cache aligned WD occupies 2 
+  // cache lines 
+  // removing the false sharing from the read
+  for (uint32_t k = 0; 
+      k < d.get().workIterations; k++)
+  {
+    // get a local copy of data
+    LocalWorkData<WD> local_wd(wd);
+    // simulate work on data
+    while (getcc_ns() - start < 
+        d.get().workCycles){}
+   
+    if (g_options.shardedWrites)
+    {
+      auto& writer = shardWriter(wd);
+      for (uint32_t it = 0; 
+          it < WD::Elems; ++it)
+        writer.increment(it);
+      continue;
+    }
+
+    uint32_t slot = writeSlot<WD>();
+    for (uint32_t it = 0; 
+        it < WD::Elems; ++it)
+    {
+      // simulate writing results
+      // This is false sharing, which
+      // cannot be avoided at times
+      // The intent is to show the 
+      // separation of the read and
+      // write data
+      bandwidth::tagWrite("wwd", &wd.write(slot, it), sizeof(uint32_t));
+      wd.write(slot, it)++;
+    }
+  }
+
+  // one commit per message, flush counts messages
+  if (g_options.shardedWrites)
+    shardWriter(wd).commit();
+}
+
+// laneLat, of a lanequeue only, also records each message by its lane
 template <typename T, typename Q, typename WD>
 void consumer(Q* q, int32_t iterations,
-    ResultsSync& rs, CycleTracker& ct, WD& wd)
+    ResultsSync& rs, CycleTracker& ct, WD& wd,
+    LatencyHistogram& lat, LaneLatency* laneLat, RunControl& ctl)
 {
-  while (Thread::g_cstart.load() == false) {}
+  ctl.arriveAndWait();
 
   T d;
   uint64_t start;
   bool work = false;
 
   ct.start();
-  for (;;)
+  while (!ctl.stopped())
   {
     CycleTracker::CheckPoint cp(ct, rs);
     // roll into CheckPoint constructor?
     cp.markOne(); 
+    quiescent(wd);
 
     start = getcc_ns();
-    work = q->pop(d);
+    // a slab message is read in its slot
+    T* m = &d;
+    uint32_t slot;
+    if constexpr (isSlab<Q>)
+      work = q->pop_slot(slot);
+    else
+      work = q->pop(d);
     if (!work)
     {
       cp.markTwo();
@@ -374,244 +900,2460 @@ void consumer(Q* q, int32_t iterations,
     }
     cp.markTwo();
 
-    // simulate work:
-    // When cache aligned WD occupies 2 
-    // cache lines 
-    // removing the false sharing from the read
-    for (uint32_t k = 0; 
-        k < d.get().workIterations; k++)
-    {
-      // get a local copy of data
-      WD local_wd(wd);
-      // simulate work on data
-      while (getcc_ns() - start < 
-          d.get().workCycles){}
-     
-      for (uint32_t it = 0; 
-          it < WriteWorkData::Elem; ++it)
-      {
-        // simulate writing results
-        // This is false sharing, which
-        // cannot be avoided at times
-        // The intent is to show the 
-        // separation of the read and
-        // write data
-        wd.wwd.data[it]++;
-      }
-    }
+    if constexpr (isSlab<Q>)
+      m = &q->at(slot);
+    readPayload(*m);
+    simulateWork(*m, wd, start);
+    recordLatency(lat, m->get());
+    if constexpr (isLaned<Q>)
+      recordLatency(laneLat->lane[bandwidth::t_popLane], m->get());
+    if constexpr (isSlab<Q>)
+      q->release(slot);
     cp.markThree();
   }
 }
 // [/include]
 
-// not used for paper
-template <typename WD>
-void worker(WD& wd)
+// NAPI style consumer. Each poll feeds a moving average of works/polls.
+// While it says busy an empty poll only pauses, as consumer() does;
+// once it drops empty polls wait doubling spins and then, at the
+// longest spin, sleep g_options.parkMicros, the way NAPI falls back to
+// interrupts. Any message resets the wait, and every budget messages
+// in a row the core is yielded to whatever else runs on it. The wait
+// is timed as part of the empty poll. laneLat as for consumer().
+template <typename T, typename Q, typename WD>
+void adaptiveConsumer(Q* q, 
+    ResultsSync& rs, CycleTracker& ct, WD& wd,
+    LatencyHistogram& lat, LaneLatency* laneLat, RunControl& ctl)
 {
-  std::cout << "Launched worker" << std::endl;
-  // simulate work
-  uint32_t producer_results[WriteWorkData::Elem];
-  for (;;)
+  // works/polls in 16.16 fixed point, over about Smoothing polls
+  constexpr int64_t Scale = 1 << 16;
+  constexpr int64_t Smoothing = 64;
+  constexpr int64_t BusyRatio = Scale / 2;
+  constexpr uint32_t MaxSpin = 1024;
+
+  ctl.arriveAndWait();
+
+  T d;
+  int64_t ratio{Scale};
+  uint32_t spin{0};
+  uint32_t run{0};
+
+  ct.start();
+  while (!ctl.stopped())
   {
-    for (uint32_t it = 0; 
-        it < WriteWorkData::Elem; ++it)
+    CycleTracker::CheckPoint cp(ct, rs);
+    cp.markOne(); 
+    quiescent(wd);
+
+    uint64_t start = getcc_ns();
+    // a slab message is read in its slot
+    T* m = &d;
+    uint32_t slot;
+    bool work;
+    if constexpr (isSlab<Q>)
+      work = q->pop_slot(slot);
+    else
+      work = q->pop(d);
+    ratio += ((work ? Scale : 0) - ratio) / Smoothing;
+    if (!work)
     {
-      // simulate consuming producers results
-      producer_results[it] = 
-        wd.wwd.data[it].load();
+      run = 0;
+      if (ratio >= BusyRatio)
+        __builtin_ia32_pause();
+      else if (spin < MaxSpin)
+      {
+        spin = spin ? spin * 2 : 1;
+        for (uint32_t i = 0; i < spin; ++i)
+          __builtin_ia32_pause();
+      }
+      else
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(g_options.parkMicros));
+      cp.markTwo();
+      continue;
     }
+    cp.markTwo();
+    spin = 0;
+
+    if constexpr (isSlab<Q>)
+      m = &q->at(slot);
+    readPayload(*m);
+    simulateWork(*m, wd, start);
+    recordLatency(lat, m->get());
+    if constexpr (isLaned<Q>)
+      recordLatency(laneLat->lane[bandwidth::t_popLane], m->get());
+    if constexpr (isSlab<Q>)
+      q->release(slot);
+    cp.markThree();
 
-    // simulate processing of results from
-    // producers
-    uint64_t start = getcc_ns();
-    // 300ns on 3GHz CPU
-    while (getcc_ns() - start < 900){} 
-    for (uint32_t it = 0; 
-        it < ReadWorkData::Elem; ++it)
+    if (g_options.budget && ++run == g_options.budget)
     {
-      // simulate writing for producers to consume
-      wd.rwd.data[it] =  producer_results[it];
+      run = 0;
+      sched_yield();
     }
   }
 }
 
-void setAffinity(	
-    std::unique_ptr<std::thread>& t 
-    , uint32_t cpuid )
+// 'r', 's' and 't' in the pc string: consumers of the first, second
+// and third stage of the multicast ring
+uint32_t ringStage(char role)
+{
+  return role == 'r' ? 1 : role == 's' ? 2 : role == 't' ? 3 : 0;
+}
+
+// 'm' cores in the pc string
+bool hasMuxedConsumers(const std::string& pc)
 {
-  cpu_set_t cpuset;
-  CPU_ZERO(&cpuset);
-  CPU_SET(cpuid, &cpuset);
+  return pc.find('m') != std::string::npos;
+}
 
-  int rc = pthread_setaffinity_np(
-      t->native_handle()
-      , sizeof(cpu_set_t)
-      , &cpuset);
+// A consumer of the multicast ring, tracked like consumer(): every
+// message is a poll and its work, a barrier read that finds nothing new
+// is a poll only. A barrier read that does find messages grants all of
+// them, the cursor is released once the batch is done.
+template <typename T, typename R, typename WD>
+void ringConsumer(R* ring, uint32_t id,
+    ResultsSync& rs, CycleTracker& ct, WD& wd,
+    LatencyHistogram& lat, RunControl& ctl)
+{
+  ctl.arriveAndWait();
 
-  std::cerr	<< "affinity " 
-    << cpuid 
-    << std::endl;
+  T d;
+  int64_t next = ring->cursor(id) + 1;
+  int64_t available = next - 1;
 
-  if (rc != 0) 
+  ct.start();
+  while (!ctl.stopped())
   {
-    std::cerr << "Error calling "
-      "pthread_setaffinity_np: "
-      << rc 
-      << "\n";
-    exit (0);
+    CycleTracker::CheckPoint cp(ct, rs);
+    cp.markOne(); 
+    quiescent(wd);
+
+    uint64_t start = getcc_ns();
+    if (next > available)
+    {
+      available = ring->barrier(id, next);
+      if (next > available)
+      {
+        bandwidth::count(bandwidth::QueueCounters::EmptyPops);
+        cp.markTwo();
+        __builtin_ia32_pause();
+        continue;
+      }
+      bandwidth::count(bandwidth::QueueCounters::RingBatches);
+    }
+    d = ring->at(next);
+    cp.markTwo();
+
+    readPayload(d);
+    simulateWork(d, wd, start);
+    recordLatency(lat, d.get());
+    if (next++ == available)
+      ring->release(id, available);
+    cp.markThree();
   }
 }
 
-// [include]
-// EX3: Begin
-template<typename T,template<class...>typename Q>
-void run ( const std::string& pc, uint64_t workCycles, uint32_t workIterations )
+// One logical consumer of a multiplexed core. Its tracker sees the time
+// parked in the scheduler as overhead and the time resumed as duty.
+template <typename T, typename Q, typename WD>
+typename CoroutineScheduler<T,Q>::Task coConsumer(
+    CoroutineScheduler<T,Q>& sched,
+    ResultsSync& rs, CycleTracker& ct, WD& wd,
+    LatencyHistogram& lat)
 {
-  using WD_t = WorkData<alignof(T)>;
-  // shared data amongst producers
-  WD_t wd;
+  T d;
 
-  std::cout	<< "Alignment of T " 
-    << alignof(T) 
-    << std::endl;
+  ct.start();
+  for (;;)
+  {
+    CycleTracker::CheckPoint cp(ct, rs);
+    cp.markOne();
+    quiescent(wd);
 
-  std::cout   << "Size of CycleTracker "
-    << sizeof(CycleTracker)
-    << std::endl;
+    // timed from the pop, as consumer() does
+    uint64_t start = co_await sched.pop(d);
+    cp.markTwo();
 
-  std::cout   << "Size of ResultsSync "
-    << sizeof(ResultsSync)
-    << std::endl;
+    readPayload(d);
+    simulateWork(d, wd, start);
+    recordLatency(lat, d.get());
+    cp.markThree();
+  }
+}
 
-  std::vector<std::unique_ptr<std::thread>> 
-    threads;
+// 'm' in the pc string, one pinned thread running
+// g_options.coroutines consumers
+template <typename T, typename Q, typename WD,
+         typename ARS, typename ACT>
+void multiplexedConsumer(Q* q, 
+    ResultsSync& rs, CycleTracker& ct,
+    ARS* crs, ACT* cct,
+    uint32_t coroutines, WD& wd, 
+    LatencyHistogram& lat, RunControl& ctl)
+{
+  CoroutineScheduler<T,Q> sched(q, coroutines);
 
-  threads.reserve(pc.length());
+  // all coroutines of the core share its histogram
+  for (uint32_t i = 0; i < coroutines; ++i)
+    sched.spawn(coConsumer<T,Q,WD>(sched, 
+          crs[i].get(), cct[i].get(), wd, lat));
 
-  // reserve enough of each for total number
-  // possible threads
-  // They will be packed together causing false
-  // sharing unless aligned to the cache-line.
-  auto rs = 
-    std::make_unique<Alignment<ResultsSync,
-      alignof(T)>[]>(pc.length());
-  
-  auto ct = 
-      std::make_unique<Alignment<CycleTracker,
-      alignof(T)>[]>(pc.length());
-
-  Q<T> q(128);
-
-  // need to make this a command line option 
-  // and do proper balancing between 
+  ctl.arriveAndWait();
+
+  // every coroutine is parked when the scheduler polls
+  sched.run(ct, rs, [&ctl, &wd] { quiescent(wd); return ctl.stopped(); });
+}
+
+// not used for paper
+template <typename WD>
+void worker(WD& wd, RunControl& ctl)
+{
+  std::cout << "Launched worker" << std::endl;
+  // simulate work
+  uint32_t producer_results[WD::Elems];
+  ctl.arriveAndWait();
+  while (!ctl.stopped())
+  {
+    for (uint32_t it = 0; 
+        it < WD::Elems; ++it)
+    {
+      // simulate consuming producers results,
+      // combining the slots of all consumers
+      if (g_options.shardedWrites)
+      {
+        producer_results[it] = wd.shards.read(it);
+        continue;
+      }
+
+      producer_results[it] = 0;
+      for (uint32_t slot = 0; slot < WD::Slots; ++slot)
+        producer_results[it] += 
+          wd.write(slot, it).load();
+    }
+
+    // simulate processing of results from
+    // producers
+    uint64_t start = getcc_ns();
+    // 300ns on 3GHz CPU
+    while (getcc_ns() - start < 900){} 
+
+    if (g_options.publish == Options::Publish::SeqLock)
+    {
+      bandwidth::tagWrite("seqlock", &wd.seqlock, sizeof(wd.seqlock));
+      wd.seqlock.write(producer_results);
+      continue;
+    }
+
+    if (g_options.publish == Options::Publish::Rcu)
+    {
+      // waits for the consumers to release an old version
+      while (!wd.rcu.tryPublish(producer_results) && !ctl.stopped())
+        __builtin_ia32_pause();
+      continue;
+    }
+
+    for (uint32_t it = 0; 
+        it < WD::Elems; ++it)
+    {
+      // simulate writing for producers to consume
+      bandwidth::tagWrite("rwd", &wd.read(it), sizeof(uint32_t));
+      wd.read(it) =  producer_results[it];
+    }
+  }
+}
+
+// A thread created with its affinity already set through the pthread
+// attributes, it never runs on another cpu, not even for its first
+// instructions.
+class PinnedThread
+{
+public:
+  template <typename F, typename... Args>
+  PinnedThread(uint32_t cpuid, F&& f, Args&&... args)
+    : fn_([cpuid, f = std::forward<F>(f), 
+        a = std::make_tuple(std::forward<Args>(args)...)]() mutable
+        {
+          Thread::t_core = cpuid;
+          std::apply(f, a);
+        })
+  {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpuid, &cpuset);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    int rc = pthread_attr_setaffinity_np(
+        &attr
+        , sizeof(cpu_set_t)
+        , &cpuset);
+
+    if (rc == 0)
+      rc = pthread_create(&t_, &attr, &PinnedThread::entry, this);
+
+    pthread_attr_destroy(&attr);
+
+    std::cerr	<< "affinity " 
+      << cpuid 
+      << std::endl;
+
+    if (rc != 0) 
+    {
+      std::cerr << "Error creating thread pinned "
+        "to cpu " << cpuid << ": "
+        << rc 
+        << "\n";
+      exit (0);
+    }
+  }
+
+  PinnedThread(const PinnedThread&) = delete;
+  PinnedThread& operator=(const PinnedThread&) = delete;
+
+  void join() { pthread_join(t_, nullptr); }
+  pthread_t native_handle() { return t_; }
+
+private:
+  static void* entry(void* p)
+  {
+    static_cast<PinnedThread*>(p)->fn_();
+    return nullptr;
+  }
+
+  std::function<void()> fn_;
+  pthread_t t_;
+};
+
+// Starts the roles of a trial as pinned threads, or as forked child
+// processes. A child inherits the affinity the parent holds at fork()
+// so, like a PinnedThread, it is pinned from its first instruction.
+class RoleLauncher
+{
+public:
+  explicit RoleLauncher(bool processes) : processes_(processes) {}
+
+  template <typename F, typename... Args>
+  void launch(uint32_t cpuid, F&& f, Args&&... args)
+  {
+    if (!processes_)
+    {
+      threads_.push_back(std::make_unique<PinnedThread>(
+            cpuid, std::forward<F>(f), std::forward<Args>(args)...));
+      return;
+    }
+
+    cpu_set_t parent;
+    sched_getaffinity(0, sizeof(cpu_set_t), &parent);
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpuid, &cpuset);
+
+    int rc = sched_setaffinity(0, sizeof(cpu_set_t), &cpuset);
+    if (rc != 0) 
+    {
+      std::cerr << "Error calling "
+        "sched_setaffinity for cpu " << cpuid << ": "
+        << errno 
+        << "\n";
+      exit (0);
+    }
+
+    // nothing buffered may be written twice
+    std::cout.flush();
+    std::cerr.flush();
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      Thread::t_core = cpuid;
+      std::apply(f, std::make_tuple(std::forward<Args>(args)...));
+      _exit(0);
+    }
+
+    sched_setaffinity(0, sizeof(cpu_set_t), &parent);
+
+    if (pid < 0)
+    {
+      std::cerr << "Error calling fork: " << errno << "\n";
+      exit (0);
+    }
+
+    std::cerr	<< "affinity " 
+      << cpuid 
+      << " pid " << pid
+      << std::endl;
+
+    children_.push_back(pid);
+  }
+
+  size_t size() const { return threads_.size() + children_.size(); }
+
+  void join()
+  {
+    for (auto& i : threads_)
+      i->join();
+
+    for (auto pid : children_)
+      waitpid(pid, nullptr, 0);
+  }
+
+private:
+  bool processes_;
+  std::vector<std::unique_ptr<PinnedThread>> threads_;
+  std::vector<pid_t> children_;
+};
+
+// Queue placed in the shared segment of a multi-process run. A fixed
+// capacity keeps the nodes inside the queue object, addressed by array
+// index, rather than on the heap of whichever process allocated them.
+template <template<class...> typename Q, typename T>
+struct SharedQueue
+{
+  using type = Q<T, boost::lockfree::capacity<128>>;
+};
+
+// Time from the first thread being created to each thread arriving
+// at the start barrier, and to the run starting
+void reportStartup(RunControl& ctl, const std::string& pc,
+    uint64_t launched, uint64_t start)
+{
+  auto us = [](uint64_t cycles) { return cycles / (g_CPUGHzSpeed * 1000); };
+
+  uint32_t slowest{0};
+  uint64_t slowestAt{0};
+  std::cout << "Ready [us]:";
+  for (uint32_t core = 0; core < pc.length(); ++core)
+  {
+    if (pc[core] != 'p' && pc[core] != 'c' && 
+        pc[core] != 'm' && pc[core] != 'w' && !ringStage(pc[core]))
+      continue;
+
+    uint64_t at = ctl.readyAt_[core].load(std::memory_order_relaxed);
+    std::cout << " " << core << ":" << us(at - launched);
+    if (at > slowestAt)
+    {
+      slowestAt = at;
+      slowest = core;
+    }
+  }
+  std::cout << std::endl;
+
+  std::cout << "Startup: all " << ctl.ready_.load() 
+    << " threads ready in " << us(start - launched) 
+    << " us, slowest core " << slowest << " at " 
+    << us(slowestAt - launched) << " us" << std::endl;
+}
+
+void reportPerf(const PerfGroup::Counts& c)
+{
+  std::cout << "Perf:";
+  for (uint32_t e = 0; e < PerfGroup::Events; ++e)
+  {
+    std::cout << (e ? ", " : " ") << PerfGroup::name(e) << " = ";
+    if (c.valid[e])
+      std::cout << c.value[e];
+    else
+      std::cout << "n/a";
+
+    if (e == PerfGroup::Instructions && c.valid[e] && 
+        c.valid[PerfGroup::Cycles] && c.value[PerfGroup::Cycles])
+      std::cout << " (IPC " << static_cast<double>(c.value[e]) / 
+        c.value[PerfGroup::Cycles] << ")";
+  }
+  std::cout << std::endl;
+}
+
+// Per coroutine breakdown of an 'm' core, the core's own
+// tracker above already covers the aggregate.
+void reportCoroutines(Results* results, uint32_t coroutines)
+{
+  uint64_t bandwidth{0};
+  for (uint32_t k = 0; k < coroutines; ++k)
+  {
+    std::cout << "  coroutine " << k 
+      << ": saturation [Cycles] = " 
+      << results[k].saturationCycles()
+      << ", Bandwidth [work/sec] = " 
+      << results[k].bandwidth() 
+      << std::endl;
+    bandwidth += results[k].bandwidth();
+  }
+  std::cout << "  coroutines Bandwidth = " 
+            << bandwidth << std::endl;
+}
+
+// [include]
+// Measurement window of one fixed duration trial
+struct Measured
+{
+  // per tracked thread
+  std::vector<Results> results;
+  // per producer, in pc string order
+  std::vector<Results> producers;
+  // per tracked thread, messages behind the producers at the end of
+  // the window, -1 for queue consumers
+  std::vector<int64_t> lag;
+  // per lane of a lanequeue, of all 'c' consumers
+  std::vector<LatencyHistogram::Snapshot> laneLatency;
+  // per tracked thread, cores' worth of CPU time used in the window
+  std::vector<double> cpu;
+  // all consumers, open loop only
+  LatencyHistogram::Snapshot latency;
+  // published read data
+  struct Reads
+  {
+    // by all consumers
+    uint64_t reads{0};
+    uint64_t retries{0};
+    // by the worker, RCU only
+    uint64_t publishes{0};
+    uint64_t stalls{0};
+
+    Reads& operator-=(const Reads& rhs)
+    {
+      reads -= rhs.reads;
+      retries -= rhs.retries;
+      publishes -= rhs.publishes;
+      stalls -= rhs.stalls;
+      return *this;
+    }
+  };
+  Reads reads;
+  // queue internals counted by the producers, and by all others
+  bandwidth::QueueCounters::Snapshot queuePush;
+  bandwidth::QueueCounters::Snapshot queuePop;
+};
+
+void reportReads(const Measured::Reads& r)
+{
+  std::cout << "Read data: " << r.reads << " reads, " << r.retries 
+    << " retries (" << (r.reads ? static_cast<double>(r.retries) / r.reads : 0)
+    << " per read)";
+  if (g_options.publish == Options::Publish::Rcu)
+    std::cout << ", " << r.publishes << " versions published, " 
+      << r.stalls << " publish attempts waiting for reclamation";
+  std::cout << std::endl;
+}
+
+// Counted by one side of the queue, nothing for queues that count
+// nothing (boost::lockfree::queue)
+void reportQueue(const char* side, const bandwidth::QueueCounters::Snapshot& s)
+{
+  using C = bandwidth::QueueCounters;
+  uint64_t any{0};
+  for (auto v : s.value)
+    any |= v;
+  if (!any)
+    return;
+
+  auto cas = [&](const char* name, C::Counter c)
+  {
+    uint64_t n = s.value[c];
+    uint64_t failed = s.value[c + 1];
+    std::cout << ", " << name << " CAS " << n << " (" << failed << " failed, "
+      << (n ? static_cast<double>(failed) / n : 0) << ")";
+  };
+
+  std::cout << "Queue " << side << ":";
+  std::cout << " empty pops " << s.value[C::EmptyPops]
+    << ", failed pushes " << s.value[C::FailedPushes];
+  cas("head", C::HeadCas);
+  cas("tail", C::TailCas);
+  cas("freelist", C::FreelistCas);
+  if (s.value[C::Eliminations])
+    std::cout << ", eliminated " << s.value[C::Eliminations];
+  if (s.value[C::BackoffPauses])
+    std::cout << ", backoff pauses " << s.value[C::BackoffPauses];
+  if (s.value[C::RingBatches])
+    std::cout << ", ring batches " << s.value[C::RingBatches];
+  if (s.value[C::BurntSlots])
+    std::cout << ", burnt slots " << s.value[C::BurntSlots];
+  if (s.value[C::CombinerPasses])
+    std::cout << ", combiner passes " << s.value[C::CombinerPasses]
+      << " (" << static_cast<double>(s.value[C::CombinedOps]) / 
+      s.value[C::CombinerPasses] << " ops per pass)";
+  if (s.value[C::CacheRefills] || s.value[C::CacheFlushes])
+    std::cout << ", node cache refills " << s.value[C::CacheRefills]
+      << ", flushes " << s.value[C::CacheFlushes];
+  std::cout << std::endl;
+}
+
+void reportProducers(const std::vector<Results>& producers)
+{
+  if (producers.empty())
+    return;
+
+  uint64_t pushes{0};
+  double ratio{0};
+  for (auto r : producers)
+  {
+    pushes += r.bandwidth();
+    ratio += r.saturationRatio();
+  }
+  std::cout << "Producers: " << pushes << " pushes/sec, "
+    "saturation [Ratio] (pushes per attempt) mean = " 
+    << ratio / producers.size() << std::endl;
+}
+
+// Nanoseconds a thread (or process) has been on a cpu, from the
+// scheduler's accounting, 0 if that is not available
+uint64_t threadCpuNs(int32_t tid)
+{
+  std::ifstream f("/proc/" + std::to_string(tid) + "/schedstat");
+  uint64_t ns{0};
+  f >> ns;
+  return ns;
+}
+
+void reportLatency(const LatencyHistogram::Snapshot& s)
+{
+  auto ns = [](uint64_t cycles) { return cycles / g_CPUGHzSpeed; };
+
+  std::cout << "Latency [ns] from intended send: p50 = " 
+    << ns(s.percentile(0.5))
+    << ", p90 = " << ns(s.percentile(0.9))
+    << ", p99 = " << ns(s.percentile(0.99))
+    << ", p99.9 = " << ns(s.percentile(0.999))
+    << ", max = " << ns(s.max())
+    << " (" << s.total << " msgs)"
+    << std::endl;
+}
+
+// EX3: Begin
+// The nodes a queue keeps outside its object (threads mode), as one
+// range per contiguous run of them. Queues that allocate as they go
+// (fcqueue, faaqueue, boost::lockfree::queue) leave theirs unnamed.
+template <typename Q>
+void registerQueueNodes(FalseSharingDetector& fs, Q& q)
+{
+  if constexpr (requires { q.for_each_node_block([](const void*, size_t) {}); })
+  {
+    std::vector<std::pair<uintptr_t, size_t>> blocks;
+    q.for_each_node_block([&](const void* p, size_t bytes)
+        { blocks.emplace_back(reinterpret_cast<uintptr_t>(p), bytes); });
+    std::sort(blocks.begin(), blocks.end());
+
+    for (size_t i = 0; i < blocks.size(); )
+    {
+      auto [begin, bytes] = blocks[i];
+      while (++i < blocks.size() && blocks[i].first == begin + bytes)
+        bytes += blocks[i].second;
+      fs.registerRange("queue nodes", reinterpret_cast<const void*>(begin), bytes);
+    }
+  }
+}
+
+// One launch of the pc string on queue type QT. With measured == nullptr 
+// it reports every second forever, otherwise it warms up, measures for 
+// g_options.duration, stops and joins every role and returns the
+// results of the measurement window. Everything the roles share lives
+// in one SharedArena, a shared memory segment when Processes is set.
+template<typename T, typename QT, bool Processes, typename WL>
+void trialOn ( const std::string& pc, uint64_t workCycles, uint32_t workIterations,
+    Measured* measured )
+{
+  using Layout_t = WorkData<WL::align ? WL::align : alignof(T), WL>;
+  using WD_t = WorkState<Layout_t>;
+  using RS_t = Alignment<ResultsSync, alignof(T)>;
+  using CT_t = Alignment<CycleTracker, alignof(T)>;
+  using LAT_t = Alignment<LatencyHistogram, alignof(T)>;
+
+  if (pc.length() > RunControl::MaxThreads)
+  {
+    std::cout << "pc string longer than " 
+      << RunControl::MaxThreads << std::endl;
+    exit(0);
+  }
+
+  // with a ring every producer pushes to it, a queue consumer would
+  // poll an empty queue
+  if (std::any_of(pc.begin(), pc.end(), ringStage) &&
+      pc.find_first_of("cm") != std::string::npos)
+  {
+    std::cout << "ring consumers (r, s, t) and queue consumers (c, m) "
+      "cannot share the pc string " << pc << std::endl;
+    exit(0);
+  }
+
+  // the coroutine scheduler pops by value, it has no slot to hand on
+  if (isSlab<QT> && hasMuxedConsumers(pc))
+  {
+    std::cout << "slab queue messages are read in place, 'm' consumers "
+      "would copy them: " << pc << std::endl;
+    exit(0);
+  }
+
+  // trackers for the logical consumers of 'm' cores
+  uint32_t coroutines = g_options.coroutines;
+  uint32_t muxCores = std::count(pc.begin(), pc.end(), 'm');
+
+  constexpr bool laned = isLaned<QT>;
+  SharedArena arena((64 << 20) + pc.length() * sizeof(LAT_t) 
+      + (laned ? pc.length() * sizeof(LaneLatency) : 0), Processes);
+  if (Processes)
+    std::cout << "Shared memory segment " << arena.name() << std::endl;
+
+  // shared data amongst producers
+  WD_t& wd = *arena.make<WD_t>();
+
+  std::cout	<< "Alignment of T " 
+    << alignof(T) 
+    << std::endl;
+
+  std::cout   << "Size of CycleTracker "
+    << sizeof(CycleTracker)
+    << std::endl;
+
+  std::cout   << "Size of ResultsSync "
+    << sizeof(ResultsSync)
+    << std::endl;
+
+  reportFootprint<QT, T>(std::cout, "Queue footprint", 128);
+
+  // adjust for physical cpu/core layout, 
+  // each role is pinned to its pc string position
+  RoleLauncher threads(Processes);
+
+  // reserve enough of each for total number
+  // possible threads
+  // They will be packed together causing false
+  // sharing unless aligned to the cache-line.
+  RS_t* rs = arena.makeArray<RS_t>(pc.length());
+  CT_t* ct = arena.makeArray<CT_t>(pc.length());
+
+  // producers, by pc string position
+  RS_t* prs = arena.makeArray<RS_t>(pc.length());
+  CT_t* pct = arena.makeArray<CT_t>(pc.length());
+
+  RS_t* crs = arena.makeArray<RS_t>(muxCores * coroutines);
+  CT_t* cct = arena.makeArray<CT_t>(muxCores * coroutines);
+
+  // coroutines run by each tracked index, 0 for 'c'
+  std::vector<uint32_t> muxed;
+  muxed.reserve(pc.length());
+
+  // pc string position of each tracked index
+  std::vector<uint32_t> trackedCore;
+  trackedCore.reserve(pc.length());
+
+  LAT_t* lat = arena.makeArray<LAT_t>(pc.length());
+  LaneLatency* laneLat = laned 
+    ? arena.makeArray<LaneLatency>(pc.length()) : nullptr;
+
+  QT* q;
+  if constexpr (Processes)
+    q = arena.make<QT>();
+  else
+    q = arena.make<QT>(128);
+
+  RunControl& ctl = *arena.make<RunControl>();
+
+  // Ring consumers in the pc string replace the queue: producers push
+  // to the ring and every ring consumer sees every message. The stages
+  // present, of 'r', 's' and 't', are numbered from 0 in that order.
+  using Ring_t = Disruptor<T, 1024, RunControl::MaxThreads>;
+  Ring_t* ring = nullptr;
+  uint32_t ringStages[4]{};
+  for (auto i : pc)
+    ringStages[ringStage(i)] = 1;
+  if (ringStages[1] + ringStages[2] + ringStages[3])
+  {
+    ring = arena.make<Ring_t>();
+    uint32_t next{0};
+    for (uint32_t s = 1; s < 4; ++s)
+      ringStages[s] = ringStages[s] ? next++ : 0;
+  }
+
+  // The line tables of tag mode live in this process, one per core
+  // plus one for this (the reporting) thread.
+  auto fsMode = g_options.falseSharing;
+  if (Processes && fsMode == FalseSharingDetector::Mode::Tag)
+  {
+    std::cout << "falsesharing=tag needs threads, disabled" << std::endl;
+    fsMode = FalseSharingDetector::Mode::Off;
+  }
+
+  std::unique_ptr<FalseSharingDetector> fs;
+  uint32_t reporterCore = pc.length();
+  if (fsMode != FalseSharingDetector::Mode::Off)
+  {
+    fs = std::make_unique<FalseSharingDetector>(pc.length() + 1, fsMode);
+    fs->registerRange("queue", q, sizeof(QT));
+    registerQueueNodes(*fs, *q);
+    fs->registerRange("wd", &wd, sizeof(Layout_t));
+    fs->registerRange("wd.shards", &wd.shards, sizeof(wd.shards));
+    fs->registerRange("wd.seqlock", &wd.seqlock, sizeof(wd.seqlock));
+    fs->registerRange("wd.rcu", &wd.rcu, sizeof(wd.rcu));
+    fs->registerRange("wd.readStats", &wd.readStats, sizeof(wd.readStats));
+    fs->registerRange("rs", rs, pc.length() * sizeof(RS_t));
+    fs->registerRange("ct", ct, pc.length() * sizeof(CT_t));
+    fs->registerRange("producer rs", prs, pc.length() * sizeof(RS_t));
+    fs->registerRange("producer ct", pct, pc.length() * sizeof(CT_t));
+    fs->registerRange("coroutine rs", crs, muxCores * coroutines * sizeof(RS_t));
+    fs->registerRange("coroutine ct", cct, muxCores * coroutines * sizeof(CT_t));
+    fs->registerRange("lat", lat, pc.length() * sizeof(LAT_t));
+    if (laned)
+      fs->registerRange("lane lat", laneLat, pc.length() * sizeof(LaneLatency));
+    fs->registerRange("RunControl", &ctl, sizeof(ctl));
+    if (ring)
+      fs->registerRange("ring", ring, sizeof(Ring_t));
+
+    if (fsMode == FalseSharingDetector::Mode::Tag)
+    {
+      Thread::t_core = reporterCore;
+      g_falseSharing = fs.get();
+      bandwidth::g_tagWrite = tagFalseSharing;
+    }
+  }
+
+  // need to do proper balancing between 
   // consumers and producers
-  uint32_t iterations = 1000000000;
+  uint32_t iterations = g_options.messages;
+
+  // Open loop rate per producer. A consumer serves a message
+  // in about workCycles (the simulated work of every iteration
+  // is timed from the same start) so nominal capacity is 
+  // consumer cores * cycles per second / workCycles.
+  uint32_t producers = std::count(pc.begin(), pc.end(), 'p');
+  uint32_t consumers = std::count(pc.begin(), pc.end(), 'c') + muxCores;
+  // each ring consumer serves every message
+  if (ring)
+    consumers = 1;
+  double rate = g_options.rate;
+  if (g_options.load > 0 && producers)
+    rate = g_options.load * consumers * g_CPUGHzSpeed * 1e9 
+      / workCycles / producers;
+
+  double intervalCycles = rate > 0 ? g_CPUGHzSpeed * 1e9 / rate : 0;
+  if (rate > 0)
+    std::cout << "Open loop rate per producer = " 
+      << rate << " msgs/sec" << std::endl;
+
+  uint32_t core{0};
+  uint32_t index{0};
+  uint32_t muxIndex{0};
+
+  // ring consumer id of each tracked index, -1 for queue consumers
+  std::vector<int32_t> ringId;
+  ringId.reserve(pc.length());
+
+  auto launchProducer = [&](auto* target)
+  {
+    using Target_t = std::remove_pointer_t<decltype(target)>;
+    if (rate > 0)
+    {
+      threads.launch(core, openLoopProducer<T,Target_t>
+           , target 
+           , iterations
+           , workCycles
+           , workIterations
+           , intervalCycles
+           , core
+           , std::ref(prs[core].get())
+           , std::ref(pct[core].get())
+           , std::ref(ctl));
+    }
+    else
+    {
+      threads.launch(core, producer<T,Target_t>
+           , target 
+           , iterations
+           , workCycles
+           , workIterations
+           , std::ref(prs[core].get())
+           , std::ref(pct[core].get())
+           , std::ref(ctl));
+    }
+  };
+
+  uint64_t launched = getcc_ns();
+  for (auto i : pc)
+  {
+    if (i == 'p' && ring)
+      launchProducer(ring);
+    else if (i == 'p')
+      launchProducer(q);
+    else if (i == 'c' && g_options.adaptivePoll)
+    {
+      trackedCore.push_back(core);
+      threads.launch(core, adaptiveConsumer<T,QT,WD_t>
+           , q
+           , std::ref(rs[index].get())
+           , std::ref(ct[index].get())
+           , std::ref(wd)
+           , std::ref(lat[index].get())
+           , laned ? &laneLat[index] : nullptr
+           , std::ref(ctl));
+      muxed.push_back(0);
+      ringId.push_back(-1);
+      ++index;
+    }
+    else if (i == 'c')
+    {
+      trackedCore.push_back(core);
+      threads.launch(core, consumer<T,QT,WD_t>
+           , q
+           , iterations
+           , std::ref(rs[index].get())
+           , std::ref(ct[index].get())
+           , std::ref(wd)
+           , std::ref(lat[index].get())
+           , laned ? &laneLat[index] : nullptr
+           , std::ref(ctl));
+      muxed.push_back(0);
+      ringId.push_back(-1);
+      ++index;
+    }
+    else if (ringStage(i))
+    {
+      uint32_t id = ring->addConsumer(ringStages[ringStage(i)]);
+      trackedCore.push_back(core);
+      threads.launch(core, ringConsumer<T,Ring_t,WD_t>
+           , ring
+           , id
+           , std::ref(rs[index].get())
+           , std::ref(ct[index].get())
+           , std::ref(wd)
+           , std::ref(lat[index].get())
+           , std::ref(ctl));
+      muxed.push_back(0);
+      ringId.push_back(id);
+      ++index;
+    }
+    else if (i == 'm')
+    {
+      uint32_t first = muxIndex++ * coroutines;
+      trackedCore.push_back(core);
+
+      threads.launch(core, multiplexedConsumer<T,QT,WD_t,RS_t,CT_t>
+           , q
+           , std::ref(rs[index].get())
+           , std::ref(ct[index].get())
+           , &crs[first]
+           , &cct[first]
+           , coroutines
+           , std::ref(wd)
+           , std::ref(lat[index].get())
+           , std::ref(ctl));
+      muxed.push_back(coroutines);
+      ringId.push_back(-1);
+      ++index;
+    }
+    else if (i == 'w')
+    {
+      threads.launch(core, worker<WD_t>, 
+           std::ref(wd),
+           std::ref(ctl));
+    }
+
+    ++core;
+  }
+
+  uint64_t start = ctl.waitReady(threads.size());
+  reportStartup(ctl, pc, launched, start);
+
+  // Hardware counters of every role, opened between the barrier
+  // and the start so they cover the whole run.
+  auto perf = std::make_unique<PerfGroup[]>(pc.length());
+  auto perfPrev = std::make_unique<PerfGroup::Counts[]>(pc.length());
+  auto isRole = [&](uint32_t core)
+  {
+    return pc[core] == 'p' || pc[core] == 'c' || 
+      pc[core] == 'm' || pc[core] == 'w' || ringStage(pc[core]);
+  };
+
+  if (g_options.perf)
+  {
+    uint32_t opened{0};
+    for (uint32_t c = 0; c < pc.length(); ++c)
+      if (isRole(c) && perf[c].open(ctl.tid_[c].load()))
+      {
+        // the first interval's deltas start here, from zero if the
+        // group has not run yet
+        if (!perf[c].read(perfPrev[c]))
+          std::fill(std::begin(perfPrev[c].valid),
+              std::end(perfPrev[c].valid), true);
+        ++opened;
+      }
+
+    std::cout << "Perf counters opened for " << opened 
+      << " of " << threads.size() << " threads" << std::endl;
+  }
+
+  if (fsMode == FalseSharingDetector::Mode::Perf)
+  {
+    uint32_t opened{0};
+    for (uint32_t c = 0; c < pc.length(); ++c)
+      if (isRole(c) && fs->openSampling(c, ctl.tid_[c].load()))
+        ++opened;
+
+    std::cout << "Store sampling opened for " << opened 
+      << " of " << threads.size() << " threads" << std::endl;
+  }
+
+  // sleeps, keeping the perf sample buffers drained
+  auto sleepFor = [&](double seconds)
+  {
+    using namespace std::chrono;
+    auto until = steady_clock::now() + 
+      duration_cast<steady_clock::duration>(duration<double>(seconds));
+    while (steady_clock::now() < until)
+    {
+      std::this_thread::sleep_for(std::min<steady_clock::duration>(
+            milliseconds(100), until - steady_clock::now()));
+      if (fsMode == FalseSharingDetector::Mode::Perf)
+        fs->drain();
+    }
+  };
+
+  FalseSharingDetector::Snapshot fsPrev;
+  auto reportFalseSharing = [&]()
+  {
+    if (!fs)
+      return;
+    FalseSharingDetector::Snapshot now;
+    fs->snapshot(now);
+    fs->report(std::cout, now, fsPrev);
+    if (fsMode == FalseSharingDetector::Mode::Tag)
+      std::cout << "  (core " << reporterCore 
+        << " is the reporting thread)" << std::endl;
+    fsPrev = std::move(now);
+  };
+
+  // counts since the previous call for this core
+  auto perfDelta = [&](uint32_t core)
+  {
+    PerfGroup::Counts now;
+    perf[core].read(now);
+    PerfGroup::Counts d = now;
+    d -= perfPrev[core];
+    perfPrev[core] = now;
+    return d;
+  };
+
+  // producers and worker, consumers report with their tracker
+  auto reportUntrackedPerf = [&]()
+  {
+    for (uint32_t c = 0; c < pc.length(); ++c)
+    {
+      if (pc[c] != 'p' && pc[c] != 'w')
+        continue;
+      std::cout << "core " << c << " " << pc[c] << " ";
+      reportPerf(perfDelta(c));
+    }
+  };
+
+  ctl.release();
+
+  // running latency counts of all consumers
+  auto latencyTotal = [&](LatencyHistogram::Snapshot& total)
+  {
+    LatencyHistogram::Snapshot s;
+    for ( uint32_t i = 0; i < index; ++i)
+    {
+      lat[i].get().snapshot(s);
+      total += s;
+    }
+  };
+
+  // per lane, of all 'c' consumers
+  uint32_t lanes{0};
+  if constexpr (laned)
+    lanes = q->lanes();
+  auto laneTotal = [&](std::vector<LatencyHistogram::Snapshot>& total)
+  {
+    total.assign(lanes, LatencyHistogram::Snapshot());
+    LatencyHistogram::Snapshot s;
+    for ( uint32_t i = 0; i < index; ++i)
+      for (uint32_t l = 0; l < lanes; ++l)
+      {
+        laneLat[i].lane[l].snapshot(s);
+        total[l] += s;
+      }
+  };
+
+  bool published = g_options.publish != Options::Publish::Atomic;
+  auto reads = [&]
+  { 
+    Measured::Reads r;
+    r.reads = wd.readStats.read(WD_t::Reads);
+    r.retries = wd.readStats.read(WD_t::Retries);
+    r.publishes = wd.rcu.publishes();
+    r.stalls = wd.rcu.stalls();
+    return r;
+  };
+
+  // counted by the producers, or by every other role
+  auto queueTotal = [&](bool push)
+  {
+    bandwidth::QueueCounters::Snapshot total, s;
+    for (uint32_t c = 0; c < pc.length(); ++c)
+    {
+      if ((pc[c] == 'p') != push)
+        continue;
+      ctl.queue_[c].snapshot(s);
+      total += s;
+    }
+    return total;
+  };
+
+  // CPU time of the tracked threads and the time it was read at
+  struct CpuTimes
+  {
+    std::vector<uint64_t> ns;
+    std::chrono::steady_clock::time_point at;
+  };
+  auto cpuTimes = [&]()
+  {
+    CpuTimes t;
+    for ( uint32_t i = 0; i < index; ++i)
+      t.ns.push_back(threadCpuNs(ctl.tid_[trackedCore[i]].load()));
+    t.at = std::chrono::steady_clock::now();
+    return t;
+  };
+  // cores' worth of CPU used by tracked thread i since prev
+  auto cpuUsage = [&](const CpuTimes& now, const CpuTimes& prev, uint32_t i)
+  {
+    double wall = std::chrono::duration<double, std::nano>(
+        now.at - prev.at).count();
+    return wall > 0 ? (now.ns[i] - prev.ns[i]) / wall : 0.0;
+  };
+
+  auto producerResults = [&](std::vector<Results>& r)
+  {
+    r.clear();
+    for (uint32_t c = 0; c < pc.length(); ++c)
+      if (pc[c] == 'p')
+        r.push_back(pct[c].get().getResults(prs[c].get(), true));
+  };
+
+  if (measured)
+  {
+    LatencyHistogram::Snapshot warm;
+    std::vector<LatencyHistogram::Snapshot> warmLanes;
+
+    sleepFor(g_options.warmup);
+    for ( uint32_t i = 0; i < index; ++i)
+      ct[i].get().getResults(rs[i].get(), true);
+    latencyTotal(warm);
+    laneTotal(warmLanes);
+    for (uint32_t c = 0; c < pc.length(); ++c)
+      perfDelta(c);
+    if (fs)
+      fs->snapshot(fsPrev);
+    Measured::Reads warmReads = reads();
+    auto warmPush = queueTotal(true);
+    auto warmPop = queueTotal(false);
+    producerResults(measured->producers);
+    CpuTimes warmCpu = cpuTimes();
+
+    sleepFor(g_options.duration);
+    CpuTimes endCpu = cpuTimes();
+    measured->cpu.resize(index);
+    for ( uint32_t i = 0; i < index; ++i)
+      measured->cpu[i] = cpuUsage(endCpu, warmCpu, i);
+    measured->results.resize(index);
+    for ( uint32_t i = 0; i < index; ++i)
+      measured->results[i] = 
+        ct[i].get().getResults(rs[i].get(), true);
+    measured->latency = LatencyHistogram::Snapshot();
+    latencyTotal(measured->latency);
+    measured->latency -= warm;
+    laneTotal(measured->laneLatency);
+    for (uint32_t l = 0; l < lanes; ++l)
+      measured->laneLatency[l] -= warmLanes[l];
+    measured->reads = reads();
+    measured->reads -= warmReads;
+    producerResults(measured->producers);
+    measured->queuePush = queueTotal(true);
+    measured->queuePush -= warmPush;
+    measured->queuePop = queueTotal(false);
+    measured->queuePop -= warmPop;
+    measured->lag.resize(index);
+    for ( uint32_t i = 0; i < index; ++i)
+      measured->lag[i] = ringId[i] < 0 ? -1 : ring->lag(ringId[i]);
+
+    if (g_options.perf)
+    {
+      for (uint32_t c = 0; c < pc.length(); ++c)
+      {
+        if (!isRole(c))
+          continue;
+        std::cout << "core " << c << " " << pc[c] << " ";
+        reportPerf(perfDelta(c));
+      }
+    }
+    reportFalseSharing();
+
+    ctl.stop_.store(true);
+    threads.join();
+    bandwidth::g_tagWrite = nullptr;
+    return;
+  }
+
+  // reports until killed, nothing would remove the name
+  arena.unlink();
+
+  auto results = 
+    std::make_unique<Results[]>(index);
+
+  auto coResults = 
+    std::make_unique<Results[]>(muxCores * coroutines);
+
+  auto latPrev = 
+    std::make_unique<LatencyHistogram::Snapshot[]>(index);
+
+  std::vector<LatencyHistogram::Snapshot> lanePrev(
+      index * lanes, LatencyHistogram::Snapshot());
+
+  Measured::Reads readsPrev;
+  bandwidth::QueueCounters::Snapshot pushPrev, popPrev;
+  std::vector<Results> pushResults;
+  CpuTimes cpuPrev = cpuTimes();
+
+  for (;;)
+  {
+    sleepFor(1);
+    for ( uint32_t i = 0; i < index; ++i)
+      results[i] = 
+        ct[i].get().getResults(rs[i].get(), true);
+
+    for ( uint32_t i = 0; i < muxCores * coroutines; ++i)
+      coResults[i] = 
+        cct[i].get().getResults(crs[i].get(), true);
+
+    CpuTimes cpuNow = cpuTimes();
+
+    uint64_t totalBandwidth{0};
+    std::cout << "----" << std::endl;
+    std::cout << "workCycles = " << workCycles 
+              << std::endl;
+    std::cout << "workIterations = " 
+              << workIterations 
+              << std::endl;
+
+    uint32_t coFirst{0};
+    for ( uint32_t i = 0; i < index; ++i)
+    {
+      // T1 Begin
+      std::cout << "Temporal: saturation [Cycles]" 
+        "= " << results[i].saturationCycles() 
+        << std::endl;
+      std::cout << "Temporal: saturation [Ratio]"
+        " =  " << results[i].saturationRatio() 
+        << std::endl;
+      std::cout << "Spatial: Bandwidth [work/sec]" 
+        " = " << results[i].bandwidth() 
+        << std::endl;
+      totalBandwidth += results[i].bandwidth();
+      // T1 End
+
+      if (isTimed<T>)
+      {
+        LatencyHistogram::Snapshot s;
+        lat[i].get().snapshot(s);
+        LatencyHistogram::Snapshot interval = s;
+        interval -= latPrev[i];
+        latPrev[i] = s;
+        reportLatency(interval);
+
+        for (uint32_t l = 0; l < lanes; ++l)
+        {
+          laneLat[i].lane[l].snapshot(s);
+          interval = s;
+          interval -= lanePrev[i * lanes + l];
+          lanePrev[i * lanes + l] = s;
+          std::cout << "Lane " << l << " ";
+          reportLatency(interval);
+        }
+      }
+
+      std::cout << "CPU usage [cores] = " 
+        << cpuUsage(cpuNow, cpuPrev, i) << std::endl;
+
+      if (g_options.perf)
+        reportPerf(perfDelta(trackedCore[i]));
+
+      if (ringId[i] >= 0)
+        std::cout << "Ring consumer stage " << ring->stage(ringId[i])
+          << " lag [msgs] = " << ring->lag(ringId[i]) << std::endl;
+
+      if (muxed[i])
+        reportCoroutines(&coResults[coFirst], muxed[i]);
+      coFirst += muxed[i];
+    }
+    cpuPrev = cpuNow;
+
+    if (g_options.perf)
+      reportUntrackedPerf();
+    reportFalseSharing();
+
+    if (published)
+    {
+      Measured::Reads r = reads();
+      Measured::Reads interval = r;
+      interval -= readsPrev;
+      reportReads(interval);
+      readsPrev = r;
+    }
+
+    producerResults(pushResults);
+    uint32_t producer{0};
+    for (uint32_t c = 0; c < pc.length(); ++c)
+    {
+      if (pc[c] != 'p')
+        continue;
+      Results& r = pushResults[producer++];
+      std::cout << "Producer core " << c 
+        << ": saturation [Cycles] = " << r.saturationCycles()
+        << ", [Ratio] = " << r.saturationRatio()
+        << ", Bandwidth [msgs/sec] = " << r.bandwidth() 
+        << std::endl;
+    }
+
+    auto interval = [](auto now, auto& prev)
+    {
+      auto d = now;
+      d -= prev;
+      prev = now;
+      return d;
+    };
+    reportQueue("push side", interval(queueTotal(true), pushPrev));
+    reportQueue("pop side", interval(queueTotal(false), popPrev));
+
+    std::cout << "Total Bandwidth = " 
+              << totalBandwidth << std::endl;
+    std::cout << "----\n" << std::endl;
+  }
+}
+
+// WithProcs false leaves out the procs=1 instantiation of trialOn, for
+// sweeps of many types that run in threads only
+template<typename T,template<class...>typename Q, typename WL, 
+  bool WithProcs = true>
+void trial ( const std::string& pc, uint64_t workCycles, uint32_t workIterations,
+    Measured* measured )
+{
+  if constexpr (WithProcs)
+  {
+    if (g_options.processes)
+    {
+      trialOn<T, typename SharedQueue<Q,T>::type, true, WL>(
+          pc, workCycles, workIterations, measured);
+      return;
+    }
+  }
+  trialOn<T, Q<T>, false, WL>(
+      pc, workCycles, workIterations, measured);
+}
+
+// mean, sample standard deviation and 95% confidence 
+// interval half width of repeated measurements
+struct Summary
+{
+  double mean{0};
+  double stddev{0};
+  double ci95{0};
+};
+
+Summary summarize(const std::vector<double>& v)
+{
+  // two sided 95% student t for 1..30 degrees of freedom
+  static const double t95[] = { 0, 
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+
+  Summary r;
+  if (v.empty())
+    return r;
+
+  for (auto x : v)
+    r.mean += x;
+  r.mean /= v.size();
+
+  if (v.size() < 2)
+    return r;
+
+  for (auto x : v)
+    r.stddev += (x - r.mean) * (x - r.mean);
+  r.stddev = std::sqrt(r.stddev / (v.size() - 1));
+
+  size_t df = v.size() - 1;
+  double t = df <= 30 ? t95[df] : 1.96;
+  r.ci95 = t * r.stddev / std::sqrt(v.size());
+  return r;
+}
+
+std::ostream& operator<<(std::ostream& os, const Summary& s)
+{
+  return os << "mean = " << s.mean 
+            << ", stddev = " << s.stddev
+            << ", 95% CI = +/- " << s.ci95;
+}
+
+// Statistics of the repeats of run() other than the total bandwidth it
+// returns, for the sweeps that table them
+struct RunSummary
+{
+  Summary retriesPerRead;
+  Summary pushesPerSec;
+  // mean over the consumers
+  Summary saturationRatio;
+  // total of the consumers, cores
+  Summary cpuUsage;
+  // all consumers, open loop only
+  Summary latencyP99;
+  // per lane of a lanequeue
+  std::vector<Summary> laneP99;
+};
+
+// Continuous reporting unless g_options.duration is set, in which case
+// the pc string is run g_options.repeats times and the statistics of
+// total bandwidth are returned.
+template<typename T,template<class...>typename Q, 
+  typename WL = DefaultLayout, bool WithProcs = true>
+Summary run ( const std::string& pc, uint64_t workCycles, uint32_t workIterations,
+    RunSummary* stats = nullptr )
+{
+  if (g_options.duration <= 0)
+  {
+    trial<T,Q,WL,WithProcs>(pc, workCycles, workIterations, nullptr);
+    return Summary();
+  }
+
+  // [thread][repeat]
+  std::vector<std::vector<double>> bandwidth, satCycles, satRatio, lag;
+  // [lane][repeat]
+  std::vector<std::vector<double>> lanes;
+  std::vector<double> total, p50, p99, p999, retries, pushes;
+  // mean over the consumers of each repeat
+  std::vector<double> meanSatRatio;
+  // total of the tracked threads of each repeat
+  std::vector<double> cpu;
+  bool published = g_options.publish != Options::Publish::Atomic;
+
+  for (uint32_t r = 0; r < g_options.repeats; ++r)
+  {
+    Measured m;
+    trial<T,Q,WL,WithProcs>(pc, workCycles, workIterations, &m);
+    auto& results = m.results;
+
+    bandwidth.resize(results.size());
+    satCycles.resize(results.size());
+    satRatio.resize(results.size());
+    lag.resize(results.size());
+
+    double sum{0}, ratios{0};
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      ratios += results[i].saturationRatio();
+      if (m.lag[i] >= 0)
+      {
+        std::cout << "ring consumer " << i << ": lag [msgs] = " 
+                  << m.lag[i] << std::endl;
+        lag[i].push_back(m.lag[i]);
+      }
+      bandwidth[i].push_back(results[i].bandwidth());
+      satCycles[i].push_back(results[i].saturationCycles());
+      satRatio[i].push_back(results[i].saturationRatio());
+      sum += results[i].bandwidth();
+    }
+    total.push_back(sum);
+    meanSatRatio.push_back(results.empty() ? 0 : ratios / results.size());
+
+    double cores{0};
+    for (size_t i = 0; i < m.cpu.size(); ++i)
+    {
+      std::cout << "consumer " << i << ": CPU usage [cores] = " 
+                << m.cpu[i] << std::endl;
+      cores += m.cpu[i];
+    }
+    cpu.push_back(cores);
+
+    std::cout << "repeat " << r << ": Total Bandwidth = " 
+              << sum << std::endl;
+
+    if (isTimed<T>)
+    {
+      reportLatency(m.latency);
+      p50.push_back(m.latency.percentile(0.5) / g_CPUGHzSpeed);
+      p99.push_back(m.latency.percentile(0.99) / g_CPUGHzSpeed);
+      p999.push_back(m.latency.percentile(0.999) / g_CPUGHzSpeed);
+
+      lanes.resize(m.laneLatency.size());
+      for (size_t l = 0; l < m.laneLatency.size(); ++l)
+      {
+        std::cout << "Lane " << l << " ";
+        reportLatency(m.laneLatency[l]);
+        lanes[l].push_back(m.laneLatency[l].percentile(0.99) / g_CPUGHzSpeed);
+      }
+    }
+
+    if (published)
+    {
+      reportReads(m.reads);
+      retries.push_back(m.reads.reads ? 
+          static_cast<double>(m.reads.retries) / m.reads.reads : 0);
+    }
+
+    reportProducers(m.producers);
+    double pushed{0};
+    for (auto p : m.producers)
+      pushed += p.bandwidth();
+    pushes.push_back(pushed);
+    reportQueue("push side", m.queuePush);
+    reportQueue("pop side", m.queuePop);
+  }
+
+  std::cout << "==== " << g_options.repeats << " repeats, warmup " 
+            << g_options.warmup << "s, duration " 
+            << g_options.duration << "s ====" << std::endl;
+
+  for (size_t i = 0; i < bandwidth.size(); ++i)
+  {
+    std::cout << "consumer " << i << std::endl;
+    std::cout << "  Temporal: saturation [Cycles] " 
+              << summarize(satCycles[i]) << std::endl;
+    std::cout << "  Temporal: saturation [Ratio] " 
+              << summarize(satRatio[i]) << std::endl;
+    std::cout << "  Spatial: Bandwidth [work/sec] " 
+              << summarize(bandwidth[i]) << std::endl;
+    if (!lag[i].empty())
+      std::cout << "  Ring lag [msgs] " 
+                << summarize(lag[i]) << std::endl;
+  }
+
+  Summary s = summarize(total);
+  std::cout << "Total Bandwidth " << s << std::endl;
+
+  if (isTimed<T>)
+  {
+    std::cout << "Latency p50 [ns] " << summarize(p50) << std::endl;
+    std::cout << "Latency p99 [ns] " << summarize(p99) << std::endl;
+    std::cout << "Latency p99.9 [ns] " << summarize(p999) << std::endl;
+    if (stats)
+      stats->laneP99.clear();
+    for (size_t l = 0; l < lanes.size(); ++l)
+    {
+      std::cout << "Lane " << l << " latency p99 [ns] " 
+                << summarize(lanes[l]) << std::endl;
+      if (stats)
+        stats->laneP99.push_back(summarize(lanes[l]));
+    }
+  }
+  if (published)
+  {
+    std::cout << "Read retries per read " << summarize(retries) << std::endl;
+    if (stats)
+      stats->retriesPerRead = summarize(retries);
+  }
+  std::cout << "Producer pushes/sec " << summarize(pushes) << std::endl;
+  std::cout << "Consumer CPU usage [cores] " << summarize(cpu) << std::endl;
+  if (stats)
+  {
+    stats->cpuUsage = summarize(cpu);
+    if (isTimed<T>)
+      stats->latencyP99 = summarize(p99);
+    stats->pushesPerSec = summarize(pushes);
+    stats->saturationRatio = summarize(meanSatRatio);
+  }
+  std::cout << "====\n" << std::endl;
+
+  return s;
+}
+// [/include]
+
+// The sweeps compare fixed duration runs, of 1 second unless duration=
+// is set
+void sweepDuration()
+{
+  if (g_options.duration <= 0)
+    g_options.duration = 1;
+}
+
+// The runs of a sweep and the table they end with: one row per run with
+// its pushes and consumer bandwidth, then any further columns the sweep
+// writes to the row's more.
+class SweepTable
+{
+public:
+  struct Row
+  {
+    std::string config;
+    RunSummary stats;
+    Summary consumed;
+    // further columns, ", name value" each
+    std::ostringstream more;
+  };
+
+  // Banner of the run of pc as config, f(&stats) runs it and returns
+  // the consumer bandwidth
+  template <typename F>
+  Row& run(const std::string& pc, const std::string& config, F&& f)
+  {
+    std::cout << "==== " << pc << " " << config << " ====" << std::endl;
+    Row& row = rows_.emplace_back();
+    row.config = config;
+    row.consumed = f(&row.stats);
+    return row;
+  }
+
+  // what is what the sweep varies, params any settings of its own
+  void print(const std::string& what, const std::string& pc, 
+      uint32_t workCycles, uint32_t workIterations, 
+      const std::string& params = "") const
+  {
+    size_t width{0};
+    for (auto& r : rows_)
+      width = std::max(width, r.config.size());
+
+    std::cout << "==== " << what << ", " << pc << ", workCycles " 
+      << workCycles << ", workIterations " << workIterations 
+      << params << " ====" << std::endl;
+    for (auto& r : rows_)
+      std::cout << std::left << std::setw(width) << r.config << std::right 
+        << " pushes/sec " << std::setw(10) << r.stats.pushesPerSec.mean 
+        << " (+/- " << r.stats.pushesPerSec.ci95 << ")"
+        << ", consumed [work/sec] " << std::setw(10) << r.consumed.mean 
+        << " (+/- " << r.consumed.ci95 << ")" << r.more.str() << std::endl;
+    std::cout << "====\n" << std::endl;
+  }
+
+private:
+  std::vector<Row> rows_;
+};
+
+// The pc string with only its first n producers
+std::string firstProducers(const std::string& pc, uint32_t n)
+{
+  std::string r = pc;
+  uint32_t seen{0};
+  for (auto& i : r)
+    if (i == 'p' && ++seen > n)
+      i = '-';
+  return r;
+}
+
+// The pc string with only its first n consumer cores, 'c' or 'm'
+std::string firstConsumers(const std::string& pc, uint32_t n)
+{
+  std::string r = pc;
+  uint32_t seen{0};
+  for (auto& i : r)
+    if ((i == 'c' || i == 'm') && ++seen > n)
+      i = '-';
+  return r;
+}
+
+// One consumer thread, 'm' coroutines share their core's thread
+bool singleConsumer(const std::string& pc)
+{
+  return std::count(pc.begin(), pc.end(), 'c') + 
+    std::count(pc.begin(), pc.end(), 'm') == 1;
+}
+
+// cl: payload padded to the cache line on boost::lockfree::queue
+// queue: payload at its natural alignment on boost::lockfree::queue
+// nocl: payload at its natural alignment on gqueue
+// compact, fc, faa, mpsc, lane: natural alignment on cqueue, fcqueue, 
+// faaqueue, mpscqueue, lanequeue
+template <typename Bench>
+Summary runLayout(const std::string& cl, const std::string& pc,
+    uint32_t workCycles, uint32_t workIterations, 
+    RunSummary* stats = nullptr)
+{
+  if (cl == "cl")
+  {
+    return run<Alignment<
+      Bench
+      , fut_std::
+        hardware_destructive_interference_size>
+      , boost::lockfree::queue> 
+      (pc, workCycles, workIterations, stats);
+  }
+  else if (cl == "queue")
+  {
+    return run<Alignment<
+      Bench 
+      , alignof(Bench)>
+      , boost::lockfree::queue> 
+      (pc, workCycles, workIterations, stats);
+  }
+  else if (cl == "compact")
+  {
+    return run<Alignment<
+      Bench 
+      , alignof(Bench)>
+      , boost::lockfree::cqueue> 
+      (pc, workCycles, workIterations, stats);
+  }
+  else if (cl == "fc")
+  {
+    return run<Alignment<
+      Bench 
+      , alignof(Bench)>
+      , boost::lockfree::fcqueue> 
+      (pc, workCycles, workIterations, stats);
+  }
+  else if (cl == "faa")
+  {
+    return run<Alignment<
+      Bench 
+      , alignof(Bench)>
+      , boost::lockfree::faaqueue> 
+      (pc, workCycles, workIterations, stats);
+  }
+  else if (cl == "lane")
+  {
+    return run<Alignment<
+      Bench 
+      , alignof(Bench)>
+      , boost::lockfree::lanequeue> 
+      (pc, workCycles, workIterations, stats);
+  }
+  else if (cl == "mpsc")
+  {
+    if (!singleConsumer(pc))
+    {
+      std::cout << "mpsc needs exactly one 'c' or 'm' consumer in " 
+        << pc << ", skipped" << std::endl;
+      return Summary();
+    }
+    return run<Alignment<
+      Bench 
+      , alignof(Bench)>
+      , boost::lockfree::mpscqueue> 
+      (pc, workCycles, workIterations, stats);
+  }
+  else
+  {
+    return run<Alignment<
+      Bench 
+      , alignof(Bench)>
+      , boost::lockfree::gqueue> 
+      //, boost::lockfree::bad_queue>
+      (pc, workCycles, workIterations, stats);
+  }
+}
+
+// Fixed duration runs of each queue, all with the payload at its natural
+// alignment, for 1 up to all the producers of the pc string, then for 1
+// up to all its consumers, the other roles in place: pushes and consumer
+// bandwidth against producer and consumer count.
+template <typename Bench>
+void fanInSweep(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations)
+{
+  static const char* queues[] = { "queue", "nocl", "fc", "faa", "mpsc" };
+  uint32_t producers = std::count(pc.begin(), pc.end(), 'p');
+  uint32_t consumers = std::count(pc.begin(), pc.end(), 'c') + 
+    std::count(pc.begin(), pc.end(), 'm');
+
+  SweepTable table;
+  auto runQueues = [&](const std::string& run_pc, const std::string& count)
+  {
+    for (auto name : queues)
+    {
+      if (name == std::string("mpsc") && !singleConsumer(run_pc))
+        continue;
+      table.run(run_pc, count + " " + name, [&](RunSummary* stats) 
+          {
+            return runLayout<Bench>(name, run_pc, 
+                workCycles, workIterations, stats);
+          });
+    }
+  };
+
+  for (uint32_t n = 1; n <= producers; ++n)
+    runQueues(firstProducers(pc, n), "producers " + std::to_string(n));
+  // all consumers already ran with all producers
+  for (uint32_t n = 1; n < consumers; ++n)
+    runQueues(firstConsumers(pc, n), "consumers " + std::to_string(n));
+
+  table.print("fan-in and fan-out", pc, workCycles, workIterations);
+}
+
+// Footprint of every queue variant for payload T, with the 128 node
+// reserve of a trial
+template <typename T>
+void reportFootprints()
+{
+  reportFootprint<boost::lockfree::queue<T>, T>(std::cout, "boost::lockfree::queue", 128);
+  reportFootprint<boost::lockfree::gqueue<T>, T>(std::cout, "gqueue", 128);
+  reportFootprint<boost::lockfree::bad_queue<T>, T>(std::cout, "bad_queue", 128);
+  reportFootprint<boost::lockfree::cqueue<T>, T>(std::cout, "cqueue", 128);
+  reportFootprint<boost::lockfree::fcqueue<T>, T>(std::cout, "fcqueue", 128);
+  reportFootprint<boost::lockfree::faaqueue<T>, T>(std::cout, "faaqueue", 128);
+  reportFootprint<boost::lockfree::mpscqueue<T>, T>(std::cout, "mpscqueue", 128);
+  reportFootprint<boost::lockfree::lanequeue<T>, T>(std::cout, "lanequeue", 128);
+  reportFootprint<boost::lockfree::slabqueue<T>, T>(std::cout, "slabqueue", 128);
+  reportFootprint<boost::lockfree::queue<T, boost::lockfree::capacity<128>>, T>(
+      std::cout, "boost::lockfree::queue<128>", 128);
+  reportFootprint<boost::lockfree::gqueue<T, boost::lockfree::capacity<128>>, T>(
+      std::cout, "gqueue<128>", 128);
+  reportFootprint<boost::lockfree::cqueue<T, boost::lockfree::capacity<128>>, T>(
+      std::cout, "cqueue<128>", 128);
+  reportFootprint<boost::lockfree::fcqueue<T, boost::lockfree::capacity<128>>, T>(
+      std::cout, "fcqueue<128>", 128);
+  reportFootprint<boost::lockfree::faaqueue<T, boost::lockfree::capacity<128>>, T>(
+      std::cout, "faaqueue<128>", 128);
+  reportFootprint<boost::lockfree::mpscqueue<T, boost::lockfree::capacity<128>>, T>(
+      std::cout, "mpscqueue<128>", 128);
+  reportFootprint<boost::lockfree::lanequeue<T, boost::lockfree::capacity<128>>, T>(
+      std::cout, "lanequeue<128>", 128);
+  reportFootprint<boost::lockfree::slabqueue<T, boost::lockfree::capacity<128>>, T>(
+      std::cout, "slabqueue<128>", 128);
+}
+
+// Bytes per message of each queue variant, then the bandwidth of the
+// padded (nocl) and compact node layouts on the pc string
+template <typename Bench>
+void footprint(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations)
+{
+  std::cout << "==== queue footprint [bytes] ====" << std::endl;
+  reportFootprints<Alignment<Bench, alignof(Bench)>>();
+  reportFootprints<Alignment<Bench, 
+    fut_std::hardware_destructive_interference_size>>();
+  std::cout << "====\n" << std::endl;
+
+  std::vector<std::pair<std::string, Summary>> rows;
+  for (auto layout : { "nocl", "compact" })
+  {
+    std::cout << "==== " << layout << " ====" << std::endl;
+    rows.emplace_back(layout, runLayout<Bench>(layout, pc, 
+          workCycles, workIterations));
+  }
 
-  uint32_t core{0};
-  uint32_t index{0};
-  for (auto i : pc)
+  std::cout << "==== node layouts, " << pc << ", workCycles " 
+    << workCycles << ", workIterations " << workIterations 
+    << " ====" << std::endl;
+  for (auto& [name, s] : rows)
+    std::cout << std::left << std::setw(10) << name << std::right 
+      << " Total Bandwidth [work/sec] " << s << std::endl;
+  std::cout << "====\n" << std::endl;
+}
+
+template <typename L, typename Bench>
+std::string layoutName()
+{
+  using WD = WorkData<L::align ? L::align : alignof(Bench), L>;
+  return "align " + (L::align ? std::to_string(L::align) : 
+      std::to_string(alignof(Bench)) + "(T)")
+    + ", elems " + std::to_string(L::elems)
+    + ", pad " + std::to_string(L::pad)
+    + ", slots " + std::to_string(L::slots)
+    + (L::interleaved ? ", AoS" : ", SoA")
+    + ", " + std::to_string(sizeof(WD)) + " bytes";
+}
+
+// Fixed duration runs of the pc string (on the nocl queue) with each 
+// WorkData layout, then a table of total consumer bandwidth.
+template <typename Bench, typename... Layouts>
+void layoutSweep(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations)
+{
+  std::vector<std::pair<std::string, Summary>> rows;
+
+  ([&]
+   {
+     std::string name = layoutName<Layouts, Bench>();
+     std::cout << "==== layout " << name << " ====" << std::endl;
+     rows.emplace_back(name, run<Alignment<Bench, alignof(Bench)>
+         , boost::lockfree::gqueue, Layouts>
+         (pc, workCycles, workIterations));
+   }(), ...);
+
+  std::cout << "==== WorkData layouts, " << pc << ", workCycles " 
+    << workCycles << ", workIterations " << workIterations 
+    << " ====" << std::endl;
+  for (auto& [name, s] : rows)
+    std::cout << std::left << std::setw(56) << name << std::right 
+      << " Total Bandwidth [work/sec] " << s << std::endl;
+  std::cout << "====\n" << std::endl;
+}
+
+// Fixed duration runs of the pc string (on the nocl queue) with each
+// way of publishing the worker's read data
+template <typename Bench>
+void publishSweep(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations)
+{
+  static const std::pair<const char*, Options::Publish> modes[] = 
+    { { "atomic", Options::Publish::Atomic }
+    , { "seqlock", Options::Publish::SeqLock }
+    , { "rcu", Options::Publish::Rcu } };
+
+  std::vector<std::tuple<std::string, Summary, Summary>> rows;
+  for (auto& [name, mode] : modes)
   {
-    if (i == 'p')
+    std::cout << "==== publish " << name << " ====" << std::endl;
+    g_options.publish = mode;
+    RunSummary stats;
+    Summary s = run<Alignment<Bench, alignof(Bench)>
+      , boost::lockfree::gqueue>(pc, workCycles, workIterations, &stats);
+    rows.emplace_back(name, s, stats.retriesPerRead);
+  }
+
+  std::cout << "==== read data publication, " << pc << ", workCycles " 
+    << workCycles << ", workIterations " << workIterations 
+    << " ====" << std::endl;
+  for (auto& [name, s, retries] : rows)
+  {
+    std::cout << std::left << std::setw(10) << name << std::right 
+      << " Total Bandwidth [work/sec] " << s << std::endl;
+    if (retries.mean > 0)
+      std::cout << std::setw(10) << "" << " retries per read " 
+        << retries << std::endl;
+  }
+  std::cout << "====\n" << std::endl;
+}
+
+// Fixed duration runs of the nocl queue with each CAS backoff policy,
+// without and with elimination, for 1 up to all the producers of the
+// pc string: pushes and consumer bandwidth against producer count.
+template <typename Bench>
+void backoffSweep(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations)
+{
+  static const std::pair<const char*, bandwidth::Backoff> policies[] = 
+    { { "none", bandwidth::Backoff::None }
+    , { "exp", bandwidth::Backoff::Exponential }
+    , { "proportional", bandwidth::Backoff::Proportional } };
+
+  // elimination=<slots> sets the slots of the elimination runs
+  uint32_t slots = bandwidth::g_eliminationSlots ? 
+    bandwidth::g_eliminationSlots : 4;
+  uint32_t producers = std::count(pc.begin(), pc.end(), 'p');
+
+  SweepTable table;
+  for (uint32_t n = 1; n <= producers; ++n)
+  {
+    std::string run_pc = firstProducers(pc, n);
+    for (auto& [name, policy] : policies)
     {
-      threads.push_back(
-          std::make_unique<std::thread>
-          (producer<T,Q<T>>
-           , &q 
-           , iterations
-           , workCycles
-           , workIterations));
-      setAffinity(*threads.rbegin(), core);
+      for (uint32_t elimination : { 0u, slots })
+      {
+        bandwidth::g_backoff = policy;
+        bandwidth::g_eliminationSlots = elimination;
+        table.run(run_pc, "producers " + std::to_string(n) + " backoff " 
+            + name + (elimination ? "+elimination" : ""), 
+            [&](RunSummary* stats) 
+            {
+              return run<Alignment<Bench, alignof(Bench)>
+                , boost::lockfree::gqueue>(run_pc, 
+                    workCycles, workIterations, stats);
+            });
+      }
     }
-    else if (i == 'c')
-    {
-      threads.push_back(
-          std::make_unique<std::thread>		  
-          (consumer<T,Q<T>,WD_t>
-           , &q
-           , iterations
-           , std::ref(rs[index].get())
-           , std::ref(ct[index].get())
-           , std::ref(wd)));
-      ++index;
+  }
 
-      // adjust for physical cpu/core layout
-      setAffinity(*threads.rbegin(), core);
-    }
-    else if (i == 'w')
-    {
-      threads.push_back(
-          std::make_unique<std::thread>		  
-          (worker<WD_t>, 
-           std::ref(wd)));
+  table.print("CAS backoff", pc, workCycles, workIterations, 
+      ", elimination slots " + std::to_string(slots));
+}
 
-      // adjust for physical cpu/core layout
-      setAffinity(*threads.rbegin(), core);
-    }
+// Fixed duration runs of the pc string on one gqueue, then on a
+// lanequeue of one lane and of lanes=<k> lanes served in strict priority
+// and in weighted round robin: the cost of the lanes and of each
+// service, with the p99 of every lane when the producers are open loop.
+template <typename Bench>
+void laneSweep(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations)
+{
+  uint32_t lanes = std::max(1u, std::min(bandwidth::g_lanes, bandwidth::MaxLanes));
 
-    ++core;
-  }
+  using T = Alignment<Bench, alignof(Bench)>;
+  SweepTable table;
+  table.run(pc, "gqueue", [&](RunSummary* stats) 
+      {
+        return run<T, boost::lockfree::gqueue>(pc, 
+            workCycles, workIterations, stats);
+      });
 
-  Thread::g_cstart.store(true);
-  usleep(500000);
-  Thread::g_pstart.store(true);
+  const std::tuple<const char*, uint32_t, bandwidth::LaneService> configs[] = 
+    { { "1 lane", 1, bandwidth::LaneService::Strict }
+    , { "strict", lanes, bandwidth::LaneService::Strict }
+    , { "weighted", lanes, bandwidth::LaneService::Weighted } };
 
-  auto results = 
-    std::make_unique<Results[]>(index);
+  for (auto& [name, n, service] : configs)
+  {
+    bandwidth::g_lanes = n;
+    bandwidth::g_laneService = service;
+
+    auto& row = table.run(pc, n == 1 ? std::string(name) 
+        : std::to_string(n) + " lanes " + name, [&](RunSummary* stats) 
+        {
+          return run<T, boost::lockfree::lanequeue>(pc, 
+              workCycles, workIterations, stats);
+        });
+    for (size_t l = 0; l < row.stats.laneP99.size(); ++l)
+      row.more << ", lane " << l << " p99 [ns] " << row.stats.laneP99[l].mean;
+  }
 
-  for (;;)
+  table.print("lanes", pc, workCycles, workIterations);
+}
+
+// Fixed duration runs of the nocl queue at closed loop and each load=
+// level (default 0.1,0.5,0.9), with the consumer's pop fast paths off,
+// peek only, prefetch only and both: consumer saturation and producer
+// pushes against load.
+void fastPathSweep(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations)
+{
+  static const std::tuple<const char*, bool, bool> configs[] = 
+    { { "plain", false, false }
+    , { "peek", true, false }
+    , { "prefetch", false, true }
+    , { "peek+prefetch", true, true } };
+
+  std::vector<double> loads = g_options.loads;
+  if (loads.empty())
+    loads = { 0.1, 0.5, 0.9 };
+  loads.insert(loads.begin(), 0.0);
+
+  SweepTable table;
+  for (auto load : loads)
   {
-    sleep(1);
-    for ( uint32_t i = 0; i < index; ++i)
-      results[i] = 
-        ct[i].get().getResults(rs[i].get(), true);
+    g_options.load = load;
+    for (auto& [name, peek, prefetch] : configs)
+    {
+      bandwidth::g_popPeek = peek;
+      bandwidth::g_popPrefetch = prefetch;
+
+      std::ostringstream config;
+      config << "load " << load << " " << name;
+      auto& row = table.run(pc, config.str(), [&](RunSummary* stats) 
+          {
+            if (g_options.openLoop())
+              return run<Alignment<TimedBenchmark, alignof(TimedBenchmark)>
+                , boost::lockfree::gqueue>(pc, workCycles, workIterations, stats);
+            return run<Alignment<Benchmark, alignof(Benchmark)>
+              , boost::lockfree::gqueue>(pc, workCycles, workIterations, stats);
+          });
+      row.more << ", consumer saturation [Ratio] " 
+        << std::setw(8) << row.stats.saturationRatio.mean 
+        << " (+/- " << row.stats.saturationRatio.ci95 << ")";
+    }
+  }
 
-    uint64_t totalBandwidth{0};
-    std::cout << "----" << std::endl;
-    std::cout << "workCycles = " << workCycles 
-              << std::endl;
-    std::cout << "workIterations = " 
-              << workIterations 
-              << std::endl;
+  table.print("pop fast path", pc, workCycles, workIterations);
+}
 
-    for ( uint32_t i = 0; i < index; ++i)
+// Fixed duration runs of the pc string for each payload size: the
+// throughput curve of message size, in messages and in bytes. The
+// message is copied in and out by value on one queue of each node kind,
+// boost::lockfree::queue, gqueue, cqueue (bounded like the slab) and
+// faaqueue, and written and read in place on slabqueue, passing a slot
+// index (not with 'm' consumers). A non empty only runs just the queues
+// it names. Threads only, each size and queue is a run instantiation
+// and the procs=1 ones would double the build.
+template <typename Bench, uint32_t... Sizes>
+void payloadSweep(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations, 
+    const std::vector<std::string>& only = {})
+{
+  using RunFn = Summary (*)(const std::string&, uint64_t, uint32_t, RunSummary*);
+
+  SweepTable table;
+  ([&]
+   {
+     using P = Payload<Bench, Sizes>;
+     using L = DefaultLayout;
+     const std::pair<const char*, RunFn> queues[] = 
+       { { "queue", run<P, boost::lockfree::queue, L, false> }
+       , { "gqueue", run<P, boost::lockfree::gqueue, L, false> }
+       , { "cqueue", run<P, boost::lockfree::cqueue, L, false> }
+       , { "faaqueue", run<P, boost::lockfree::faaqueue, L, false> }
+       , { "slabqueue", run<P, boost::lockfree::slabqueue, L, false> } };
+
+     for (auto& [name, runOn] : queues)
+     {
+       if (!only.empty() 
+           && std::find(only.begin(), only.end(), name) == only.end())
+         continue;
+       if (name == std::string("slabqueue") && hasMuxedConsumers(pc))
+         continue;
+       auto& row = table.run(pc, std::to_string(Sizes) + " bytes " + name, 
+           [&](RunSummary* stats) 
+           {
+             return runOn(pc, workCycles, workIterations, stats);
+           });
+       row.more << ", [bytes/sec] " << std::setw(12) 
+         << row.consumed.mean * Sizes;
+     }
+   }(), ...);
+
+  table.print("payload size", pc, workCycles, workIterations);
+}
+
+// Fixed duration runs of the nocl queue with busy polling and with
+// adaptive polling consumers, closed loop and at each load= level
+// (default 0.1,0.5,0.9): throughput, latency and the CPU the
+// consumers burn for it.
+void pollSweep(const std::string& pc, 
+    uint32_t workCycles, uint32_t workIterations)
+{
+  std::vector<double> loads = g_options.loads;
+  if (loads.empty())
+    loads = { 0.1, 0.5, 0.9 };
+  loads.insert(loads.begin(), 0.0);
+
+  SweepTable table;
+  for (auto load : loads)
+  {
+    g_options.load = load;
+    for (bool adaptive : { false, true })
     {
-      // T1 Begin
-      std::cout << "Temporal: saturation [Cycles]" 
-        "= " << results[i].saturationCycles() 
-        << std::endl;
-      std::cout << "Temporal: saturation [Ratio]"
-        " =  " << results[i].saturationRatio() 
-        << std::endl;
-      std::cout << "Spatial: Bandwidth [work/sec]" 
-        " = " << results[i].bandwidth() 
-        << std::endl;
-      totalBandwidth += results[i].bandwidth();
-      // T1 End
+      g_options.adaptivePoll = adaptive;
+
+      std::ostringstream config;
+      config << "load " << load << " " << (adaptive ? "adaptive" : "busy");
+      auto& row = table.run(pc, config.str(), [&](RunSummary* stats) 
+          {
+            if (g_options.openLoop())
+              return run<Alignment<TimedBenchmark, alignof(TimedBenchmark)>
+                , boost::lockfree::gqueue>(pc, workCycles, workIterations, stats);
+            return run<Alignment<Benchmark, alignof(Benchmark)>
+              , boost::lockfree::gqueue>(pc, workCycles, workIterations, stats);
+          });
+      row.more << ", saturation [Ratio] " << std::setw(8) 
+        << row.stats.saturationRatio.mean
+        << ", CPU [cores] " << std::setw(8) << row.stats.cpuUsage.mean 
+        << " (+/- " << row.stats.cpuUsage.ci95 << ")";
+      if (load > 0)
+        row.more << ", p99 [ns] " << row.stats.latencyP99.mean;
     }
-    std::cout << "Total Bandwidth = " 
-              << totalBandwidth << std::endl;
-    std::cout << "----\n" << std::endl;
   }
 
+  std::ostringstream params;
+  params << ", budget " << g_options.budget << ", park " 
+    << g_options.parkMicros << "us";
+  table.print("consumer polling", pc, workCycles, workIterations, 
+      params.str());
+}
 
-  for (auto& i : threads)
+// comma separated list of values
+template <typename V>
+std::vector<V> parseList(const std::string& value)
+{
+  std::vector<V> r;
+  size_t begin = 0;
+  for (;;)
   {
-    i->join();
+    size_t end = value.find(',', begin);
+    r.push_back(boost::lexical_cast<V>(
+          value.substr(begin, end - begin)));
+    if (end == std::string::npos)
+      break;
+    begin = end + 1;
   }
+  return r;
+}
+
+bool parseOption(const std::string& name, const std::string& value)
+{
+  if (name == "coroutines")
+    g_options.coroutines = 
+      std::max(1, boost::lexical_cast<int>(value));
+  else if (name == "messages")
+    g_options.messages = boost::lexical_cast<uint32_t>(value);
+  else if (name == "warmup")
+    g_options.warmup = boost::lexical_cast<double>(value);
+  else if (name == "duration")
+    g_options.duration = boost::lexical_cast<double>(value);
+  else if (name == "repeats")
+    g_options.repeats = 
+      std::max(1, boost::lexical_cast<int>(value));
+  else if (name == "procs")
+    g_options.processes = boost::lexical_cast<bool>(value);
+  else if (name == "perf")
+    g_options.perf = boost::lexical_cast<bool>(value);
+  else if (name == "hitm")
+    PerfGroup::rawHitm() = std::stoull(value, nullptr, 0);
+  else if (name == "snoop")
+    PerfGroup::rawSnoop() = std::stoull(value, nullptr, 0);
+  else if (name == "writes")
+  {
+    if (value == "shared")
+      g_options.shardedWrites = false;
+    else if (value == "sharded")
+      g_options.shardedWrites = true;
+    else
+      return false;
+  }
+  else if (name == "flush")
+    g_options.flush = 
+      std::max(1, boost::lexical_cast<int>(value));
+  else if (name == "publish")
+  {
+    if (value == "atomic")
+      g_options.publish = Options::Publish::Atomic;
+    else if (value == "seqlock")
+      g_options.publish = Options::Publish::SeqLock;
+    else if (value == "rcu")
+      g_options.publish = Options::Publish::Rcu;
+    else
+      return false;
+  }
+  else if (name == "falsesharing")
+  {
+    if (value == "perf")
+      g_options.falseSharing = FalseSharingDetector::Mode::Perf;
+    else if (value == "tag")
+      g_options.falseSharing = FalseSharingDetector::Mode::Tag;
+    else if (value == "off")
+      g_options.falseSharing = FalseSharingDetector::Mode::Off;
+    else
+      return false;
+  }
+  else if (name == "fsperiod")
+    FalseSharingDetector::period() = 
+      std::max(1, boost::lexical_cast<int>(value));
+  else if (name == "backoff")
+  {
+    if (value == "none")
+      bandwidth::g_backoff = bandwidth::Backoff::None;
+    else if (value == "exp")
+      bandwidth::g_backoff = bandwidth::Backoff::Exponential;
+    else if (value == "proportional")
+      bandwidth::g_backoff = bandwidth::Backoff::Proportional;
+    else
+      return false;
+  }
+  else if (name == "backoffmax")
+    bandwidth::g_backoffMax = 
+      std::max(1, boost::lexical_cast<int>(value));
+  else if (name == "elimination")
+    bandwidth::g_eliminationSlots = boost::lexical_cast<uint32_t>(value);
+  else if (name == "lanes")
+    bandwidth::g_lanes = std::clamp(
+        boost::lexical_cast<uint32_t>(value), 1u, bandwidth::MaxLanes);
+  else if (name == "laneservice")
+  {
+    if (value == "strict")
+      bandwidth::g_laneService = bandwidth::LaneService::Strict;
+    else if (value == "wrr")
+      bandwidth::g_laneService = bandwidth::LaneService::Weighted;
+    else
+      return false;
+  }
+  else if (name == "laneweights")
+  {
+    auto weights = parseList<uint32_t>(value);
+    for (uint32_t l = 0; l < bandwidth::MaxLanes; ++l)
+      bandwidth::g_laneWeights[l] = 
+        std::max(1u, l < weights.size() ? weights[l] : 1u);
+  }
+  else if (name == "lanemix")
+    g_options.laneMix = parseList<uint32_t>(value);
+  else if (name == "peek")
+    bandwidth::g_popPeek = boost::lexical_cast<bool>(value);
+  else if (name == "prefetch")
+    bandwidth::g_popPrefetch = boost::lexical_cast<bool>(value);
+  else if (name == "poll")
+  {
+    if (value == "busy")
+      g_options.adaptivePoll = false;
+    else if (value == "adaptive")
+      g_options.adaptivePoll = true;
+    else
+      return false;
+  }
+  else if (name == "budget")
+    g_options.budget = boost::lexical_cast<uint32_t>(value);
+  else if (name == "park")
+    g_options.parkMicros = 
+      std::max(1, boost::lexical_cast<int>(value));
+  else if (name == "nodecache")
+    bandwidth::g_nodeCacheBatch = boost::lexical_cast<uint32_t>(value);
+  else if (name == "rate")
+    g_options.rate = boost::lexical_cast<double>(value);
+  else if (name == "load")
+    g_options.loads = parseList<double>(value);
+  else if (name == "burst")
+    g_options.burst = 
+      std::max(1, boost::lexical_cast<int>(value));
+  else if (name == "arrival")
+  {
+    if (value == "constant")
+      g_options.arrival = Options::Arrival::Constant;
+    else if (value == "poisson")
+      g_options.arrival = Options::Arrival::Poisson;
+    else if (value == "bursty")
+      g_options.arrival = Options::Arrival::Bursty;
+    else
+      return false;
+  }
+  else
+    return false;
+
+  return true;
 }
-// [/include]
 
 // do we want to include main?
 int main ( int argc, char* argv[] )
 {
+  // split off the <name>=<value> options, the rest 
+  // are positional
+  std::vector<char*> args;
+  for (int i = 0; i < argc; ++i)
+  {
+    std::string a(argv[i]);
+    auto eq = a.find('=');
+    if (i == 0 || eq == std::string::npos)
+    {
+      args.push_back(argv[i]);
+      continue;
+    }
+
+    bool known = false;
+    try
+    {
+      known = parseOption(a.substr(0, eq), a.substr(eq + 1));
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+    }
+    catch (std::logic_error&)
+    {
+    }
+
+    if (!known)
+    {
+      std::cout << "Bad option " << a << std::endl;
+      return 0;
+    }
+  }
+  argc = args.size();
+  argv = args.data();
+
   if (argc < 3)
   {
     std::cout	<< "Usage: " 
       << argv[0] 
-      << " <cl|nocl|SimpleCL|SimpleNOCL> "
+      << " <cl|queue|nocl|compact|fc|faa|mpsc|lane|layouts|publish|footprint|fanin|backoff|lanes|fastpath|poll|slab|payload|SimpleCL|SimpleNOCL|AtomicSuite> "
       "<producer/consumer string (01ppcc67)> " 
       "[optional] <work cycles> default=6000"
       "[optional] <work iterations> default=10"
+      "[optional] <name>=<value> ..."
+      << std::endl;
+    std::cout << "  pc string: p producer, c consumer, "
+      "w worker, m multiplexed consumers, "
+      "r s t consumers of the first, second and third stage of a "
+      "multicast ring that replaces the queue, not with c or m"
+      << std::endl;
+    std::cout << "  queue: nocl on boost::lockfree::queue"
+      << std::endl;
+    std::cout << "  compact: nocl on the index linked, unpadded node queue"
+      << std::endl;
+    std::cout << "  fc: nocl on the flat combining queue"
+      << std::endl;
+    std::cout << "  faa: nocl on the fetch_add segmented queue"
+      << std::endl;
+    std::cout << "  mpsc: nocl on the single consumer queue, one 'c' or "
+      "'m' in the pc string"
+      << std::endl;
+    std::cout << "  lane: nocl on the multi-lane priority queue"
+      << std::endl;
+    std::cout << "  footprint: bytes per message of every queue, then "
+      "bandwidth of nocl and compact, default duration=1"
+      << std::endl;
+    std::cout << "  layouts: fixed duration run of each WorkData layout, "
+      "default duration=1"
+      << std::endl;
+    std::cout << "  publish: fixed duration run of each publish= mode, "
+      "default duration=1"
+      << std::endl;
+    std::cout << "  fanin: fixed duration run of queue, nocl, fc, faa and mpsc "
+      "(single consumer pc strings) for 1 up "
+      "to all producers, then 1 up to all consumers, default duration=1"
+      << std::endl;
+    std::cout << "  backoff: fixed duration run of each backoff= policy, "
+      "without and with elimination, for 1 up to all producers, "
+      "default duration=1"
+      << std::endl;
+    std::cout << "  lanes: fixed duration run of gqueue, one lane, and "
+      "lanes=<k> lanes in strict and weighted service, per lane latency "
+      "at the first load=, default duration=1"
+      << std::endl;
+    std::cout << "  fastpath: fixed duration run of nocl with pop's peek and "
+      "prefetch off and on, closed loop and at each load= default "
+      "0.1,0.5,0.9, default duration=1"
+      << std::endl;
+    std::cout << "  poll: fixed duration run of nocl with busy and adaptive "
+      "polling consumers, closed loop and at each load= default "
+      "0.1,0.5,0.9, default duration=1"
+      << std::endl;
+    std::cout << "  slab: fixed duration run of 64 byte to 4KiB messages "
+      "copied through gqueue and cqueue and written and read in place "
+      "in a slab, threads only, "
+      "default duration=1"
+      << std::endl;
+    std::cout << "  payload: fixed duration run of queue, gqueue, cqueue, "
+      "faaqueue and slabqueue with 8 byte to 4KiB messages, msgs/sec "
+      "and bytes/sec, threads only, "
+      "default duration=1"
+      << std::endl;
+    std::cout << "  AtomicSuite: ops/sec of each atomic primitive on the "
+      "'p' cores, duration=<sec> per run default=0.2"
+      << std::endl;
+    std::cout << "  coroutines=<n> consumers per 'm' core,"
+      " default=10" 
+      << std::endl;
+    std::cout << "  messages=<n> pushed per producer,"
+      " default=1000000000" 
+      << std::endl;
+    std::cout << "  duration=<sec> fixed duration mode, "
+      "warmup=<sec> default=1, repeats=<n> default=1" 
+      << std::endl;
+    std::cout << "  rate=<msgs/sec per producer> or "
+      "load=<fraction of capacity>[,<fraction>...] open loop, "
+      "arrival=<constant|poisson|bursty> burst=<n> default=16" 
+      << std::endl;
+    std::cout << "  procs=1 roles as processes over a shared "
+      "memory segment" 
+      << std::endl;
+    std::cout << "  perf=1 per thread hardware counters, "
+      "hitm=<raw event> snoop=<raw event> override the HITM/snoop events" 
+      << std::endl;
+    std::cout << "  writes=<shared|sharded> consumer results to the shared "
+      "wwd atomics or to per thread shards the worker combines, "
+      "flush=<n> messages between shard updates default=1" 
+      << std::endl;
+    std::cout << "  publish=<atomic|seqlock|rcu> worker updates the read "
+      "data in place, through a seqlock or as RCU versions" 
+      << std::endl;
+    std::cout << "  falsesharing=<perf|tag> cache lines written by more "
+      "than one core, from sampled stores or tagged write sites, "
+      "fsperiod=<n> sample period default=10007" 
+      << std::endl;
+    std::cout << "  backoff=<none|exp|proportional> gqueue waits after a "
+      "failed head or tail CAS, backoffmax=<pauses> default=1024, "
+      "elimination=<slots> up to 16 pushes hand values to pops "
+      "waiting on an empty queue" 
+      << std::endl;
+    std::cout << "  lanes=<k> lanes of the lane queue, up to 8, default=2, "
+      "laneservice=<strict|wrr> lane 0 first or up to laneweights=<w0,w1,...> "
+      "messages per lane in turn, lanemix=<m0,m1,...> share of each "
+      "producer's messages per lane, default even"
+      << std::endl;
+    std::cout << "  peek=1 gqueue's pop returns on an empty queue after "
+      "plain loads of the head, prefetch=1 it prefetches the node after "
+      "the one it took"
+      << std::endl;
+    std::cout << "  poll=<busy|adaptive> 'c' consumers poll in a tight loop "
+      "or back off and park when idle by their works/polls ratio, "
+      "budget=<n> messages between yields default=64 (0 never), "
+      "park=<us> default=50"
+      << std::endl;
+    std::cout << "  nodecache=<n> gqueue nodes each thread takes from "
+      "and returns to the shared freelist at once, up to 256, default=0 "
+      "(every node)" 
       << std::endl;
     return 0;
   }
@@ -636,6 +3378,10 @@ int main ( int argc, char* argv[] )
       std::cout << core << ":P ";
     else if (i == 'c')
       std::cout << core << ":C ";
+    else if (i == 'm')
+      std::cout << core << ":M ";
+    else if (ringStage(i))
+      std::cout << core << ":" << static_cast<char>(std::toupper(i)) << " ";
     else
       std::cout << core << ":N ";
 
@@ -655,23 +3401,115 @@ int main ( int argc, char* argv[] )
 
   std::string cl(argv[1]);
 
-  if (cl == "cl")
+  if (cl == "cl" || cl == "queue" || cl == "nocl" || cl == "compact" 
+      || cl == "fc" || cl == "faa" || cl == "mpsc" || cl == "lane")
   {
-    run<Alignment<
-      Benchmark
-      , fut_std::
-        hardware_destructive_interference_size>
-      , boost::lockfree::queue> 
-      (pc, workCycles, workIterations);
+    // one run per load level, or one closed loop run
+    std::vector<double> loads = g_options.loads;
+    if (loads.empty())
+      loads.push_back(0.0);
+
+    for (auto load : loads)
+    {
+      g_options.load = load;
+      if (load > 0)
+        std::cout << "==== load " << load 
+                  << " of capacity ====" << std::endl;
+
+      if (g_options.openLoop())
+        runLayout<TimedBenchmark>(cl, pc, workCycles, workIterations);
+      else
+        runLayout<Benchmark>(cl, pc, workCycles, workIterations);
+    }
   }
-  else if (cl == "nocl")
+  else if (cl == "layouts")
   {
-    run<Alignment<
-      Benchmark 
-      , alignof(Benchmark)>
-      , boost::lockfree::gqueue> 
-      //, boost::lockfree::bad_queue>
-      (pc, workCycles, workIterations);
+    sweepDuration();
+
+    // Benchmark is 4 byte aligned, align 0 packs the data
+    layoutSweep<Benchmark
+      , WorkLayout<0, 8>
+      , WorkLayout<0, 8, 64>
+      , WorkLayout<64, 8>
+      , WorkLayout<0, 4>
+      , WorkLayout<0, 16>
+      , WorkLayout<64, 16>
+      , WorkLayout<0, 8, 0, 8>
+      , WorkLayout<64, 8, 0, 8>
+      , WorkLayout<0, 8, 0, 1, true>
+      , WorkLayout<64, 8, 0, 1, true>
+      , WorkLayout<64, 8, 0, 8, true>
+      , WorkLayout<64, 8, 60, 1, true>
+      >(pc, workCycles, workIterations);
+  }
+  else if (cl == "footprint")
+  {
+    sweepDuration();
+
+    footprint<Benchmark>(pc, workCycles, workIterations);
+  }
+  else if (cl == "publish")
+  {
+    sweepDuration();
+
+    publishSweep<Benchmark>(pc, workCycles, workIterations);
+  }
+  else if (cl == "fanin")
+  {
+    sweepDuration();
+
+    fanInSweep<Benchmark>(pc, workCycles, workIterations);
+  }
+  else if (cl == "backoff")
+  {
+    sweepDuration();
+
+    backoffSweep<Benchmark>(pc, workCycles, workIterations);
+  }
+  else if (cl == "payload" || cl == "slab")
+  {
+    sweepDuration();
+
+    if (g_options.processes)
+    {
+      std::cout << cl << " runs threads only, procs=1 ignored" << std::endl;
+      g_options.processes = false;
+    }
+
+    if (cl == "payload")
+      payloadSweep<Benchmark, 8, 64, 256, 1024, 4096>(
+          pc, workCycles, workIterations);
+    else if (hasMuxedConsumers(pc))
+      std::cout << "slab needs 'c' consumers, 'm' consumers pop by value" 
+        << std::endl;
+    else
+      payloadSweep<Benchmark, 64, 256, 1024, 4096>(
+          pc, workCycles, workIterations, { "gqueue", "cqueue", "slabqueue" });
+  }
+  else if (cl == "poll")
+  {
+    sweepDuration();
+
+    pollSweep(pc, workCycles, workIterations);
+  }
+  else if (cl == "fastpath")
+  {
+    sweepDuration();
+
+    fastPathSweep(pc, workCycles, workIterations);
+  }
+  else if (cl == "lanes")
+  {
+    sweepDuration();
+
+    // the first load= level, per lane latency needs open loop
+    if (!g_options.loads.empty())
+      g_options.load = g_options.loads.front();
+
+    if (g_options.openLoop())
+      laneSweep<TimedBenchmark>(pc, workCycles, workIterations);
+    else
+      laneSweep<Benchmark>(pc, workCycles, workIterations);
   }
   else if (cl == "SimpleCL")
   {
@@ -681,6 +3519,10 @@ int main ( int argc, char* argv[] )
   {
     simpleTest<4>(pc);
   }
+  else if (cl == "AtomicSuite")
+  {
+    atomicSuite(pc);
+  }
 
   else
   {
@@ -718,7 +3560,7 @@ int simpleTest (const std::string& pc)
   std::cout << "Sizeof data = " << sizeof(data) 
             << std::endl;
 
-  std::vector<std::unique_ptr<std::thread>>
+  std::vector<std::unique_ptr<PinnedThread>>
     threads;
 
   threads.reserve(pc.length());
@@ -730,10 +3572,9 @@ int simpleTest (const std::string& pc)
     if (i == 'p')
     {
       threads.push_back(std::make_unique
-          <std::thread>(CLTest, 
+          <PinnedThread>(core, CLTest, 
             std::ref(data[idx].d)));
 
-      setAffinity(*threads.rbegin(), core);
       ++idx;
     }
     ++core;
@@ -772,3 +3613,174 @@ int simpleTest (const std::string& pc)
   return 0;
 }
 // EX1: End
+
+// Atomic primitives under contention, ops/sec of each primitive,
+// alignment and thread count, with all threads on one atomic (same
+// line) or each on its own element of an Align aligned array
+// (separate: packed into one line at 4, adjacent lines at 64, apart
+// from the adjacent line prefetcher's pair at 128).
+enum class Primitive : uint32_t
+{
+    Load
+  , Store
+  , FetchAdd
+  , Exchange
+  , Cas
+  , Primitives
+};
+
+const char* primitiveName(Primitive p)
+{
+  static const char* names[] = 
+    { "load", "store relaxed", "fetch_add", "exchange", "CAS loop" };
+  return names[static_cast<uint32_t>(p)];
+}
+
+struct alignas(fut_std::hardware_destructive_interference_size) OpsCount
+{
+  std::atomic<uint64_t> ops{0};
+};
+
+// ops of one thread until stop, the stop flag is checked every Batch
+void atomicOps(Primitive p, std::atomic<uint32_t>& d, OpsCount& count,
+    std::atomic<uint32_t>& ready, std::atomic<bool>& go, 
+    std::atomic<bool>& stop)
+{
+  constexpr uint32_t Batch = 64;
+
+  ready.fetch_add(1);
+  while (!go.load(std::memory_order_acquire))
+    __builtin_ia32_pause();
+
+  uint64_t ops{0};
+  uint32_t sink{0};
+  while (!stop.load(std::memory_order_relaxed))
+  {
+    for (uint32_t i = 0; i < Batch; ++i)
+    {
+      switch (p)
+      {
+        case Primitive::Load:
+          sink += d.load(std::memory_order_relaxed);
+          break;
+        case Primitive::Store:
+          d.store(i, std::memory_order_relaxed);
+          break;
+        case Primitive::FetchAdd:
+          d.fetch_add(1);
+          break;
+        case Primitive::Exchange:
+          sink += d.exchange(i);
+          break;
+        case Primitive::Cas:
+          {
+            uint32_t v = d.load(std::memory_order_relaxed);
+            while (!d.compare_exchange_weak(v, v + 1))
+              ;
+          }
+          break;
+        default:
+          break;
+      }
+    }
+    ops += Batch;
+  }
+
+  // keep the loads
+  asm volatile("" :: "r"(sink));
+  count.ops.store(ops, std::memory_order_relaxed);
+}
+
+// total ops/sec of threads pinned to the first cores
+template <int Align>
+double atomicRun(Primitive p, const std::vector<uint32_t>& cores, 
+    uint32_t threads, bool shared, double seconds)
+{
+  std::vector<DataTest<Align>> data(threads);
+  std::vector<OpsCount> counts(threads);
+  std::atomic<uint32_t> ready{0};
+  std::atomic<bool> go{false};
+  std::atomic<bool> stop{false};
+
+  std::vector<std::unique_ptr<PinnedThread>> pinned;
+  for (uint32_t t = 0; t < threads; ++t)
+    pinned.push_back(std::make_unique<PinnedThread>(cores[t], 
+          atomicOps, p, std::ref(data[shared ? 0 : t].d),
+          std::ref(counts[t]), std::ref(ready), std::ref(go), 
+          std::ref(stop)));
+
+  while (ready.load() < threads)
+    __builtin_ia32_pause();
+
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop.store(true);
+  for (auto& t : pinned)
+    t->join();
+  std::chrono::duration<double> elapsed = 
+    std::chrono::steady_clock::now() - start;
+
+  uint64_t ops{0};
+  for (auto& c : counts)
+    ops += c.ops.load();
+  return ops / elapsed.count();
+}
+
+template <int Align>
+void atomicRows(const std::vector<uint32_t>& cores, double seconds,
+    std::vector<std::pair<std::string, std::vector<double>>>& rows)
+{
+  for (uint32_t p = 0; p < static_cast<uint32_t>(Primitive::Primitives); ++p)
+  {
+    for (bool shared : { true, false })
+    {
+      std::string name = std::string(primitiveName(Primitive(p)))
+        + ", align " + std::to_string(Align) 
+        + (shared ? ", same line" : ", separate");
+      std::vector<double> opsPerSec;
+      for (uint32_t threads = 1; threads <= cores.size(); ++threads)
+      {
+        opsPerSec.push_back(atomicRun<Align>(Primitive(p), 
+              cores, threads, shared, seconds));
+        std::cout << name << ", " << threads << " threads: " 
+          << opsPerSec.back() << " ops/sec" << std::endl;
+      }
+      rows.emplace_back(name, opsPerSec);
+    }
+  }
+}
+
+// 'p' positions of the pc string are the cores, in order, the
+// Nth column runs on the first N of them
+int atomicSuite(const std::string& pc)
+{
+  std::vector<uint32_t> cores;
+  for (uint32_t core = 0; core < pc.length(); ++core)
+    if (pc[core] == 'p')
+      cores.push_back(core);
+
+  double seconds = g_options.duration > 0 ? g_options.duration : 0.2;
+  std::vector<std::pair<std::string, std::vector<double>>> rows;
+  atomicRows<4>(cores, seconds, rows);
+  atomicRows<64>(cores, seconds, rows);
+  atomicRows<128>(cores, seconds, rows);
+
+  std::cout << "==== atomic primitives, total Mops/sec by threads ====" 
+    << std::endl;
+  std::cout << std::left << std::setw(36) << "" << std::right;
+  for (uint32_t threads = 1; threads <= cores.size(); ++threads)
+    std::cout << std::setw(10) << threads;
+  std::cout << std::endl;
+
+  for (auto& [name, opsPerSec] : rows)
+  {
+    std::cout << std::left << std::setw(36) << name << std::right
+      << std::fixed << std::setprecision(1);
+    for (auto ops : opsPerSec)
+      std::cout << std::setw(10) << ops / 1e6;
+    std::cout << std::defaultfloat << std::endl;
+  }
+  std::cout << "====\n" << std::endl;
+  return 0;
+}
@@ -0,0 +1,266 @@
+//  lock-free queue from
+//  Michael, M. M. and Scott, M. L.,
+//  "simple, fast and practical non-blocking and blocking concurrent queue algorithms"
+//
+//  Compact variant of gqueue: nodes live in one fixed array, unpadded,
+//  and are linked by 32 bit indices. head_, tail_, the freelist head and
+//  every next link are a 32 bit index plus a 32 bit ABA tag in one 64 bit
+//  atomic, so a node is 8 bytes of link plus the payload.
+
+#ifndef BOOST_CLOCKFREE_FIFO_HPP_INCLUDED
+#define BOOST_CLOCKFREE_FIFO_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include <boost/assert.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/has_trivial_assign.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <boost/config.hpp> // for BOOST_LIKELY
+
+#include <boost/lockfree/detail/parameter.hpp>
+
+#include "queue_hooks.h"
+
+namespace boost    {
+namespace lockfree {
+
+/** The queue class provides a multi-writer/multi-reader queue over a
+ *  fixed number of nodes.
+ *
+ *  With boost::lockfree::capacity<> the nodes are stored inside the queue
+ *  object (so it can be placed in shared memory), otherwise n + 1 nodes
+ *  are allocated by the constructor. push() fails when all nodes are in
+ *  use, the queue never allocates after construction.
+ * */
+template <typename T, typename ...Options>
+class cqueue
+{
+private:
+    BOOST_STATIC_ASSERT((boost::has_trivial_destructor<T>::value));
+    BOOST_STATIC_ASSERT((boost::has_trivial_assign<T>::value));
+
+    typedef typename boost::parameter::parameters<boost::parameter::optional<tag::allocator>,
+                                                  boost::parameter::optional<tag::capacity>
+                                                 >::template bind<Options...>::type bound_args;
+
+    static const bool has_capacity = detail::extract_capacity<bound_args>::has_capacity;
+    static const size_t capacity = detail::extract_capacity<bound_args>::capacity + 1; // the queue uses one dummy node
+
+    typedef std::uint64_t tagged_index;
+    typedef ::bandwidth::QueueCounters counters;
+    static const std::uint32_t null_index = 0xffffffff;
+
+    static std::uint32_t index(tagged_index t) { return static_cast<std::uint32_t>(t); }
+    static std::uint32_t tag(tagged_index t) { return static_cast<std::uint32_t>(t >> 32); }
+    static tagged_index make(std::uint32_t i, std::uint32_t t)
+    {
+        return (static_cast<tagged_index>(t) << 32) | i;
+    }
+
+    struct node
+    {
+        // queue link, or freelist link while the node is free
+        std::atomic<tagged_index> next;
+        T data;
+    };
+
+    struct inline_nodes
+    {
+        inline_nodes(size_t) {}
+        node * get() { return nodes; }
+        node nodes[capacity];
+    };
+
+    struct allocated_nodes
+    {
+        allocated_nodes(size_t n) : nodes(new node[n]) {}
+        node * get() { return nodes.get(); }
+        std::unique_ptr<node[]> nodes;
+    };
+
+    typedef typename std::conditional<has_capacity, inline_nodes, allocated_nodes>::type storage;
+
+    BOOST_DELETED_FUNCTION(cqueue(cqueue const&))
+    BOOST_DELETED_FUNCTION(cqueue& operator= (cqueue const&))
+
+public:
+    typedef T value_type;
+
+    static const size_t node_bytes = sizeof(node);
+
+    //! Construct queue with capacity<> nodes
+    cqueue(void):
+        node_count(capacity),
+        storage_(capacity)
+    {
+        BOOST_STATIC_ASSERT(has_capacity);
+        initialize();
+    }
+
+    //! Construct queue, allocate n nodes
+    explicit cqueue(size_t n):
+        node_count(n + 1),
+        storage_(n + 1)
+    {
+        BOOST_STATIC_ASSERT(!has_capacity);
+        initialize();
+    }
+
+    size_t nodes(void) const { return node_count; }
+
+    //! Calls f(begin, bytes) for the nodes allocated by the constructor
+    template <typename F>
+    void for_each_node_block(F && f)
+    {
+        if (!has_capacity)
+            f(storage_.get(), node_count * sizeof(node));
+    }
+
+    bool empty(void) const
+    {
+        return index(head_.load()) == index(tail_.load());
+    }
+
+    bool push(T const & t)
+    {
+        std::uint32_t n = allocate();
+        if (n == null_index) {
+            ::bandwidth::count(counters::FailedPushes);
+            return false;
+        }
+
+        node & nn = at(n);
+        ::bandwidth::tagWrite("queue node", &nn, sizeof(node));
+        nn.data = t;
+        tagged_index old_next = nn.next.load(std::memory_order_relaxed);
+        nn.next.store(make(null_index, tag(old_next) + 1), std::memory_order_release);
+
+        for (;;) {
+            tagged_index tail = tail_.load(std::memory_order_acquire);
+            node & tail_node = at(index(tail));
+            tagged_index next = tail_node.next.load(std::memory_order_acquire);
+
+            tagged_index tail2 = tail_.load(std::memory_order_acquire);
+            if (BOOST_LIKELY(tail == tail2)) {
+                if (index(next) == null_index) {
+                    ::bandwidth::tagWrite("queue node next", &tail_node.next, sizeof(tail_node.next));
+                    if (::bandwidth::countCas(counters::TailCas,
+                                tail_node.next.compare_exchange_weak(next, make(n, tag(next) + 1)))) {
+                        ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+                        ::bandwidth::countCas(counters::TailCas,
+                                tail_.compare_exchange_strong(tail, make(n, tag(tail) + 1)));
+                        return true;
+                    }
+                }
+                else {
+                    ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+                    ::bandwidth::countCas(counters::TailCas,
+                            tail_.compare_exchange_strong(tail, make(index(next), tag(tail) + 1)));
+                }
+            }
+        }
+    }
+
+    bool pop(T & ret)
+    {
+        for (;;) {
+            tagged_index head = head_.load(std::memory_order_acquire);
+            tagged_index tail = tail_.load(std::memory_order_acquire);
+            tagged_index next = at(index(head)).next.load(std::memory_order_acquire);
+
+            tagged_index head2 = head_.load(std::memory_order_acquire);
+            if (BOOST_LIKELY(head == head2)) {
+                if (index(head) == index(tail)) {
+                    if (index(next) == null_index) {
+                        ::bandwidth::count(counters::EmptyPops);
+                        return false;
+                    }
+
+                    ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+                    ::bandwidth::countCas(counters::TailCas,
+                            tail_.compare_exchange_strong(tail, make(index(next), tag(tail) + 1)));
+                } else {
+                    // the freelist link of a recycled head, see gqueue
+                    if (index(next) == null_index)
+                        continue;
+
+                    // may be torn if the node was recycled, then the CAS fails
+                    ret = at(index(next)).data;
+
+                    ::bandwidth::tagWrite("queue head", &head_, sizeof(head_));
+                    if (::bandwidth::countCas(counters::HeadCas,
+                                head_.compare_exchange_weak(head, make(index(next), tag(head) + 1)))) {
+                        deallocate(index(head));
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    node & at(std::uint32_t i) { return storage_.get()[i]; }
+
+    void initialize(void)
+    {
+        BOOST_ASSERT(node_count < null_index);
+
+        // node 0 is the dummy, the rest start on the freelist
+        at(0).next.store(make(null_index, 0), std::memory_order_relaxed);
+        for (std::uint32_t i = 1; i < node_count; ++i)
+            at(i).next.store(make(i + 1 < node_count ? i + 1 : null_index, 0),
+                    std::memory_order_relaxed);
+
+        free_.store(make(node_count > 1 ? 1 : null_index, 0), std::memory_order_relaxed);
+        head_.store(make(0, 0), std::memory_order_relaxed);
+        tail_.store(make(0, 0), std::memory_order_release);
+    }
+
+    std::uint32_t allocate(void)
+    {
+        for (;;) {
+            tagged_index f = free_.load(std::memory_order_acquire);
+            if (index(f) == null_index)
+                return null_index;
+
+            tagged_index next = at(index(f)).next.load(std::memory_order_relaxed);
+            ::bandwidth::tagWrite("queue freelist", &free_, sizeof(free_));
+            if (::bandwidth::countCas(counters::FreelistCas,
+                        free_.compare_exchange_weak(f, make(index(next), tag(f) + 1))))
+                return index(f);
+        }
+    }
+
+    void deallocate(std::uint32_t n)
+    {
+        node & nn = at(n);
+        for (;;) {
+            tagged_index f = free_.load(std::memory_order_acquire);
+            tagged_index old_next = nn.next.load(std::memory_order_relaxed);
+            ::bandwidth::tagWrite("queue node", &nn.next, sizeof(nn.next));
+            nn.next.store(make(index(f), tag(old_next) + 1), std::memory_order_relaxed);
+
+            ::bandwidth::tagWrite("queue freelist", &free_, sizeof(free_));
+            if (::bandwidth::countCas(counters::FreelistCas,
+                        free_.compare_exchange_weak(f, make(n, tag(f) + 1))))
+                return;
+        }
+    }
+
+    // each on its own cache line, no further padding
+    alignas(64) std::atomic<tagged_index> head_;
+    alignas(64) std::atomic<tagged_index> tail_;
+    alignas(64) std::atomic<tagged_index> free_;
+    size_t node_count;
+
+    alignas(64) storage storage_;
+};
+
+} /* namespace lockfree */
+} /* namespace boost */
+
+#endif /* BOOST_CLOCKFREE_FIFO_HPP_INCLUDED */
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include "getcc.h"
+
+// Cooperative scheduler for many logical consumers on one pinned thread.
+//
+// Each logical consumer is a coroutine that co_awaits pop(d). Instead of
+// every coroutine polling the queue, the coroutine parks in a FIFO and the
+// scheduler is the only poller on the core: when a pop succeeds the message
+// is written straight into the longest waiting coroutine's buffer and that
+// coroutine is resumed. It runs its work and parks again at the back.
+// co_await pop(d) returns the time the successful pop started, where a
+// thread consumer would start its work.
+template <typename T, typename Q>
+class CoroutineScheduler
+{
+public:
+  struct Task
+  {
+    struct promise_type
+    {
+      Task get_return_object()
+      {
+        return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+      }
+
+      // started by the scheduler, not by the caller
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      std::suspend_always final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    Task(Task&& t) : h_(t.h_) { t.h_ = nullptr; }
+    Task(const Task&) = delete;
+    ~Task() { if (h_) h_.destroy(); }
+
+    std::coroutine_handle<promise_type> h_;
+  };
+
+  struct PopAwaiter
+  {
+    CoroutineScheduler& s_;
+    T& d_;
+
+    // always park, the scheduler does the polling
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> h) { s_.park(h, &d_); }
+    uint64_t await_resume() { return s_.popStart_; }
+  };
+
+  CoroutineScheduler(Q* q, uint32_t coroutines)
+    : q_(q)
+    , capacity_(coroutines)
+    , parked_(std::make_unique<Parked[]>(coroutines))
+  {
+    tasks_.reserve(coroutines);
+  }
+
+  PopAwaiter pop(T& d) { return PopAwaiter{*this, d}; }
+
+  void spawn(Task&& t)
+  {
+    tasks_.push_back(std::move(t));
+  }
+
+  // Ct/Rs track the core as a whole, exactly like consumer() tracks a thread:
+  // polls are the scheduler's pops, duty is the time a resumed coroutine ran.
+  template <typename Ct, typename Rs, typename Stop>
+  void run(Ct& ct, Rs& rs, Stop stop)
+  {
+    // run each coroutine up to its first pop
+    for (auto& t : tasks_)
+      t.h_.resume();
+
+    ct.start();
+    while (!stop())
+    {
+      typename Ct::CheckPoint cp(ct, rs);
+      cp.markOne();
+
+      popStart_ = getcc_ns();
+      if (!count_ || !q_->pop(*parked_[head_].d_))
+      {
+        cp.markTwo();
+        __builtin_ia32_pause();
+        continue;
+      }
+      cp.markTwo();
+
+      std::coroutine_handle<> h = parked_[head_].h_;
+      head_ = (head_ + 1) % capacity_;
+      --count_;
+      h.resume();
+
+      cp.markThree();
+    }
+  }
+
+private:
+  struct Parked
+  {
+    std::coroutine_handle<> h_;
+    T* d_{nullptr};
+  };
+
+  void park(std::coroutine_handle<> h, T* d)
+  {
+    Parked& p = parked_[(head_ + count_) % capacity_];
+    p.h_ = h;
+    p.d_ = d;
+    ++count_;
+  }
+
+  Q* q_;
+  uint32_t capacity_;
+  uint32_t head_{0};
+  uint32_t count_{0};
+  // start of the pop that resumed the running coroutine
+  uint64_t popStart_{0};
+  std::unique_ptr<Parked[]> parked_;
+  std::vector<Task> tasks_;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+#include "queue_hooks.h"
+
+// Disruptor style multicast ring.
+//
+// Producers claim a sequence, write the slot and mark it available.
+// Every consumer sees every message: it keeps its own cursor (the last
+// sequence it has processed) and waits on a barrier, the producers for
+// the first stage or the cursors of every consumer of the stage before.
+// One barrier read grants a consumer everything up to it, processed as a
+// batch with a single cursor store at the end. Producers are gated by
+// the cursors of the last stage, which wait on all the others.
+//
+// Stages and consumers are set up before any producer runs.
+template <typename T, uint32_t Size, uint32_t MaxConsumers>
+class Disruptor
+{
+  static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+public:
+  static constexpr size_t LineBytes = 64;
+  static constexpr uint32_t MaxStages = 8;
+
+  Disruptor()
+  {
+    for (auto& a : available_)
+      a.seq.store(-1, std::memory_order_relaxed);
+  }
+
+  // consumer id, stages are numbered from 0
+  uint32_t addConsumer(uint32_t stage)
+  {
+    if (consumers_ >= MaxConsumers || stage >= MaxStages)
+      std::abort();
+    stage_[consumers_] = stage;
+    stages_ = std::max(stages_, stage + 1);
+    return consumers_++;
+  }
+
+  // false when the slowest consumer of the last stage is Size behind
+  bool push(const T& t)
+  {
+    int64_t seq = claim_.load(std::memory_order_relaxed);
+    do
+    {
+      if (seq - Size > gate_.load(std::memory_order_relaxed))
+      {
+        int64_t gate = minCursor(stages_ - 1);
+        gate_.store(gate, std::memory_order_relaxed);
+        if (seq - Size > gate)
+        {
+          bandwidth::count(bandwidth::QueueCounters::FailedPushes);
+          return false;
+        }
+      }
+      bandwidth::tagWrite("ring claim", &claim_, sizeof(claim_));
+    } while (!claim_.compare_exchange_weak(seq, seq + 1,
+          std::memory_order_acq_rel));
+
+    Slot& s = slots_[seq & Mask];
+    bandwidth::tagWrite("ring slot", &s, sizeof(s));
+    s.data = t;
+    available_[seq & Mask].seq.store(seq, std::memory_order_release);
+    return true;
+  }
+
+  // Highest sequence consumer c may process: the last contiguous
+  // available one for the first stage, else the slowest cursor of
+  // the stage before. Below next when there is nothing new.
+  int64_t barrier(uint32_t c, int64_t next) const
+  {
+    uint32_t stage = stage_[c];
+    if (stage)
+      return minCursor(stage - 1);
+
+    int64_t end = claim_.load(std::memory_order_acquire);
+    int64_t seq = next;
+    while (seq < end &&
+        available_[seq & Mask].seq.load(std::memory_order_acquire) == seq)
+      ++seq;
+    return seq - 1;
+  }
+
+  const T& at(int64_t seq) const { return slots_[seq & Mask].data; }
+
+  int64_t cursor(uint32_t c) const
+  {
+    return cursors_[c].seq.load(std::memory_order_acquire);
+  }
+
+  // everything up to seq is processed by consumer c
+  void release(uint32_t c, int64_t seq)
+  {
+    bandwidth::tagWrite("ring cursor", &cursors_[c], sizeof(cursors_[c]));
+    cursors_[c].seq.store(seq, std::memory_order_release);
+  }
+
+  // claimed and not yet processed by consumer c
+  int64_t lag(uint32_t c) const
+  {
+    return claim_.load(std::memory_order_relaxed) - 1 -
+      cursors_[c].seq.load(std::memory_order_relaxed);
+  }
+
+  uint32_t consumers() const { return consumers_; }
+  uint32_t stage(uint32_t c) const { return stage_[c]; }
+
+private:
+  static constexpr int64_t Mask = Size - 1;
+
+  int64_t minCursor(uint32_t stage) const
+  {
+    int64_t min = std::numeric_limits<int64_t>::max();
+    for (uint32_t c = 0; c < consumers_; ++c)
+      if (stage_[c] == stage)
+        min = std::min(min, cursors_[c].seq.load(std::memory_order_acquire));
+    return min;
+  }
+
+  struct alignas(LineBytes) Sequence
+  {
+    std::atomic<int64_t> seq{-1};
+  };
+
+  struct Slot
+  {
+    T data;
+  };
+
+  struct Available
+  {
+    std::atomic<int64_t> seq;
+  };
+
+  // the producers'
+  alignas(LineBytes) std::atomic<int64_t> claim_{0};
+  // last seen slowest cursor of the last stage, a hint
+  alignas(LineBytes) std::atomic<int64_t> gate_{-1};
+
+  // read only once the run starts
+  alignas(LineBytes) uint32_t consumers_{0};
+  uint32_t stages_{1};
+  uint32_t stage_[MaxConsumers]{};
+
+  Sequence cursors_[MaxConsumers];
+  alignas(LineBytes) Available available_[Size];
+  alignas(LineBytes) Slot slots_[Size];
+};
@@ -0,0 +1,397 @@
+//  fetch-and-add segmented queue, after
+//  Morrison, A. and Afek, Y.,
+//  "fast concurrent queues for x86 processors" (LCRQ)
+//  and the FAA array queue of Ramalhete, P. and Correia, A.
+//
+//  The queue is a list of segments, each an array of slots with its own
+//  enqueue and dequeue index. push() and pop() claim a slot with one
+//  fetch_add on the index instead of a CAS on a shared head or tail, so
+//  threads contending on the same end do not retry. A pop that claims a
+//  slot before its push has filled it marks the slot taken and both move
+//  on to the next slot. A push that finds its segment full links a new
+//  one (the only CAS on the common path).
+//
+//  Drained segments are reclaimed with hazard pointers, one per thread,
+//  and reused through a small locked stack (taken once per segment).
+
+#ifndef BOOST_FAA_QUEUE_HPP_INCLUDED
+#define BOOST_FAA_QUEUE_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/has_trivial_assign.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <boost/config.hpp> // for BOOST_LIKELY
+
+#include <boost/lockfree/detail/copy_payload.hpp>
+#include <boost/lockfree/detail/parameter.hpp>
+
+#include "queue_hooks.h"
+
+namespace boost    {
+namespace lockfree {
+
+/** The queue class provides a multi-writer/multi-reader queue, pushing
+ *  and popping claim slots by fetch_add.
+ *
+ *  With boost::lockfree::capacity<> the segments are stored inside the
+ *  queue object (so it can be placed in shared memory), capacity<> rounded
+ *  up to whole segments plus one, and push() fails when all are in use.
+ *  Otherwise segments are allocated as needed. At most max_threads threads
+ *  use one queue.
+ * */
+template <typename T, typename ...Options>
+class faaqueue
+{
+private:
+    BOOST_STATIC_ASSERT((boost::has_trivial_destructor<T>::value));
+    BOOST_STATIC_ASSERT((boost::has_trivial_assign<T>::value));
+
+    typedef typename boost::parameter::parameters<boost::parameter::optional<tag::allocator>,
+                                                  boost::parameter::optional<tag::capacity>
+                                                 >::template bind<Options...>::type bound_args;
+
+    static const bool has_capacity = detail::extract_capacity<bound_args>::has_capacity;
+    static const size_t capacity = detail::extract_capacity<bound_args>::capacity;
+
+    typedef ::bandwidth::QueueCounters counters;
+
+    static const std::uint32_t segment_slots = 256;
+    // spins of a pop on a claimed slot not yet filled before taking it
+    static const std::uint32_t fill_wait = 64;
+    // retired segments a thread holds while they are hazards
+    static const std::uint32_t max_retired = 16;
+
+    enum slot_state : std::uint32_t { slot_empty, slot_full, slot_taken };
+
+    struct slot
+    {
+        std::atomic<std::uint32_t> state;
+        T data;
+    };
+
+    struct segment
+    {
+        void reset(void)
+        {
+            enq.store(0, std::memory_order_relaxed);
+            deq.store(0, std::memory_order_relaxed);
+            next.store(nullptr, std::memory_order_relaxed);
+            for (auto & s : slots)
+                s.state.store(slot_empty, std::memory_order_relaxed);
+        }
+
+        alignas(64) std::atomic<std::uint32_t> enq;
+        alignas(64) std::atomic<std::uint32_t> deq;
+        alignas(64) std::atomic<segment *> next;
+        alignas(64) slot slots[segment_slots];
+    };
+
+    struct inline_segments
+    {
+        static const size_t count = (capacity + segment_slots - 1) / segment_slots + 1;
+        segment * get(size_t i) { return i < count ? &segments[i] : nullptr; }
+        static void release(segment *) {}
+        segment segments[count];
+    };
+
+    struct allocated_segments
+    {
+        static segment * get(size_t) { return new segment; }
+        static void release(segment * s) { delete s; }
+    };
+
+    typedef typename std::conditional<has_capacity, inline_segments, allocated_segments>::type storage;
+
+    struct BOOST_ALIGNMENT(64) record
+    {
+        std::atomic<segment *> hazard{nullptr};
+        std::uint32_t retired_count{0};
+        segment * retired[max_retired];
+    };
+
+    BOOST_DELETED_FUNCTION(faaqueue(faaqueue const&))
+    BOOST_DELETED_FUNCTION(faaqueue& operator= (faaqueue const&))
+
+public:
+    typedef T value_type;
+
+    static constexpr std::uint32_t max_threads = 256;
+
+    static const size_t node_bytes = sizeof(slot);
+
+    //! Construct queue with capacity<> slots, in whole segments
+    faaqueue(void)
+    {
+        BOOST_STATIC_ASSERT(has_capacity);
+        initialize();
+    }
+
+    //! Construct queue, segments are allocated as needed
+    explicit faaqueue(size_t)
+    {
+        BOOST_STATIC_ASSERT(!has_capacity);
+        initialize();
+    }
+
+    ~faaqueue(void)
+    {
+        segment * s = head_.load(std::memory_order_relaxed);
+        while (s) {
+            segment * next = s->next.load(std::memory_order_relaxed);
+            storage_.release(s);
+            s = next;
+        }
+
+        while ((s = free_)) {
+            free_ = s->next.load(std::memory_order_relaxed);
+            storage_.release(s);
+        }
+
+        std::uint32_t records = (std::min)(claimed_.load(), max_threads);
+        for (std::uint32_t i = 0; i < records; ++i)
+            for (std::uint32_t k = 0; k < records_[i].retired_count; ++k)
+                storage_.release(records_[i].retired[k]);
+    }
+
+    bool push(T const & t)
+    {
+        record & r = own_record();
+        for (;;) {
+            segment * tail = protect(r, tail_);
+            std::uint32_t i = tail->enq.fetch_add(1, std::memory_order_acq_rel);
+            if (BOOST_LIKELY(i < segment_slots)) {
+                slot & s = tail->slots[i];
+                ::bandwidth::tagWrite("queue slot", &s, sizeof(s));
+                s.data = t;
+                std::uint32_t empty = slot_empty;
+                if (s.state.compare_exchange_strong(empty, slot_full, std::memory_order_release)) {
+                    r.hazard.store(nullptr, std::memory_order_release);
+                    return true;
+                }
+
+                // a pop took the slot before it was filled
+                ::bandwidth::count(counters::BurntSlots);
+                continue;
+            }
+
+            if (tail != tail_.load(std::memory_order_acquire))
+                continue;
+
+            segment * next = tail->next.load(std::memory_order_acquire);
+            if (next) {
+                ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+                ::bandwidth::countCas(counters::TailCas, tail_.compare_exchange_strong(tail, next));
+                continue;
+            }
+
+            segment * fresh = allocate();
+            if (!fresh) {
+                r.hazard.store(nullptr, std::memory_order_release);
+                ::bandwidth::count(counters::FailedPushes);
+                return false;
+            }
+
+            // t goes in the first slot of the new segment
+            fresh->enq.store(1, std::memory_order_relaxed);
+            fresh->slots[0].data = t;
+            fresh->slots[0].state.store(slot_full, std::memory_order_relaxed);
+
+            segment * null = nullptr;
+            ::bandwidth::tagWrite("queue segment next", &tail->next, sizeof(tail->next));
+            if (::bandwidth::countCas(counters::TailCas,
+                        tail->next.compare_exchange_strong(null, fresh, std::memory_order_release))) {
+                ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+                ::bandwidth::countCas(counters::TailCas, tail_.compare_exchange_strong(tail, fresh));
+                r.hazard.store(nullptr, std::memory_order_release);
+                return true;
+            }
+            deallocate(fresh);
+        }
+    }
+
+    template <typename U>
+    bool pop(U & ret)
+    {
+        record & r = own_record();
+        for (;;) {
+            segment * head = protect(r, head_);
+
+            // no index is claimed from a segment seen empty
+            if (head->deq.load(std::memory_order_acquire) >= head->enq.load(std::memory_order_acquire) &&
+                    !head->next.load(std::memory_order_acquire))
+                break;
+
+            std::uint32_t i = head->deq.fetch_add(1, std::memory_order_acq_rel);
+            if (BOOST_LIKELY(i < segment_slots)) {
+                slot & s = head->slots[i];
+                std::uint32_t state = s.state.load(std::memory_order_acquire);
+                for (std::uint32_t k = 0; state == slot_empty && k < fill_wait; ++k) {
+                    __builtin_ia32_pause();
+                    state = s.state.load(std::memory_order_acquire);
+                }
+
+                if (state == slot_empty) {
+                    ::bandwidth::tagWrite("queue slot", &s.state, sizeof(s.state));
+                    if (s.state.compare_exchange_strong(state, slot_taken, std::memory_order_acquire)) {
+                        ::bandwidth::count(counters::BurntSlots);
+                        continue;
+                    }
+                }
+
+                detail::copy_payload(s.data, ret);
+                r.hazard.store(nullptr, std::memory_order_release);
+                return true;
+            }
+
+            segment * next = head->next.load(std::memory_order_acquire);
+            if (!next)
+                break;
+
+            // the tail leaves a segment before it can be reclaimed
+            segment * tail = head;
+            ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+            tail_.compare_exchange_strong(tail, next);
+
+            ::bandwidth::tagWrite("queue head", &head_, sizeof(head_));
+            if (::bandwidth::countCas(counters::HeadCas, head_.compare_exchange_strong(head, next))) {
+                // not this thread's hazard any more either
+                r.hazard.store(nullptr, std::memory_order_release);
+                retire(r, head);
+            }
+        }
+
+        r.hazard.store(nullptr, std::memory_order_release);
+        ::bandwidth::count(counters::EmptyPops);
+        return false;
+    }
+
+private:
+    void initialize(void)
+    {
+        segment * s = allocate();
+        head_.store(s, std::memory_order_relaxed);
+        tail_.store(s, std::memory_order_release);
+    }
+
+    // the segment at src, which cannot be reclaimed until the hazard is cleared
+    segment * protect(record & r, std::atomic<segment *> & src)
+    {
+        segment * s = src.load(std::memory_order_acquire);
+        for (;;) {
+            ::bandwidth::tagWrite("queue hazard", &r.hazard, sizeof(r.hazard));
+            r.hazard.store(s, std::memory_order_seq_cst);
+            segment * again = src.load(std::memory_order_seq_cst);
+            if (again == s)
+                return s;
+            s = again;
+        }
+    }
+
+    // Reclaimed once no thread holds it as its hazard. The hazards are
+    // scanned on every retire, once per segment_slots messages, so a
+    // fixed pool does not run dry on segments waiting for a batch.
+    void retire(record & r, segment * s)
+    {
+        r.retired[r.retired_count++] = s;
+        for (;;) {
+            std::uint32_t records = (std::min)(claimed_.load(std::memory_order_acquire), max_threads);
+            std::uint32_t kept = 0;
+            for (std::uint32_t i = 0; i < r.retired_count; ++i) {
+                segment * candidate = r.retired[i];
+                bool hazard = false;
+                for (std::uint32_t k = 0; k < records && !hazard; ++k)
+                    hazard = records_[k].hazard.load(std::memory_order_seq_cst) == candidate;
+
+                if (hazard)
+                    r.retired[kept++] = candidate;
+                else
+                    deallocate(candidate);
+            }
+            r.retired_count = kept;
+            if (kept < max_retired)
+                return;
+            __builtin_ia32_pause();
+        }
+    }
+
+    segment * allocate(void)
+    {
+        segment * s = nullptr;
+        lock();
+        if ((s = free_))
+            free_ = s->next.load(std::memory_order_relaxed);
+        else
+            s = storage_.get(allocated_++);
+        unlock();
+
+        if (s)
+            s->reset();
+        return s;
+    }
+
+    void deallocate(segment * s)
+    {
+        lock();
+        s->next.store(free_, std::memory_order_relaxed);
+        free_ = s;
+        unlock();
+    }
+
+    void lock(void)
+    {
+        for (;;) {
+            if (!free_lock_.load(std::memory_order_relaxed) &&
+                    !free_lock_.exchange(true, std::memory_order_acquire))
+                return;
+            __builtin_ia32_pause();
+        }
+    }
+
+    void unlock(void)
+    {
+        free_lock_.store(false, std::memory_order_release);
+    }
+
+    // claimed once per thread, a thread serves one queue at a time
+    record & own_record(void)
+    {
+        struct claim
+        {
+            faaqueue * owner{nullptr};
+            std::uint32_t index{0};
+        };
+        thread_local claim t_claim;
+
+        if (BOOST_UNLIKELY(t_claim.owner != this)) {
+            t_claim.index = claimed_.fetch_add(1);
+            if (t_claim.index >= max_threads)
+                std::abort();
+            t_claim.owner = this;
+        }
+        return records_[t_claim.index];
+    }
+
+    alignas(64) std::atomic<segment *> head_;
+    alignas(64) std::atomic<segment *> tail_;
+
+    // segments not in use, under free_lock_
+    alignas(64) std::atomic<bool> free_lock_{false};
+    segment * free_{nullptr};
+    size_t allocated_{0};
+
+    alignas(64) std::atomic<std::uint32_t> claimed_{0};
+    record records_[max_threads];
+
+    storage storage_;
+};
+
+} /* namespace lockfree */
+} /* namespace boost */
+
+#endif /* BOOST_FAA_QUEUE_HPP_INCLUDED */
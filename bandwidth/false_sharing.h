@@ -0,0 +1,427 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// False sharing detector: which cache lines of the registered shared
+// structures are written by more than one core.
+//
+// Writes reach a per core LineTable in one of two ways:
+//  - Perf: precise store samples (and HITM load samples) with their data
+//    address, read from each role's perf ring buffer by the reporting
+//    thread. Sees every write, including inside boost::lockfree::queue,
+//    but needs PEBS and perf_event_open permission.
+//  - Tag: write sites call bandwidth::tagWrite() themselves. Works
+//    anywhere, only sees the sites that are instrumented.
+//
+// For each line written by several cores the byte offsets each core
+// wrote tell false sharing (disjoint bytes) from true sharing (same bytes).
+class FalseSharingDetector
+{
+public:
+  static constexpr uintptr_t LineBytes = 64;
+  // lines listed by report()
+  static constexpr size_t MaxRows = 24;
+
+  enum class Mode { Off, Perf, Tag };
+
+  // Cumulative per line counts of one core, written by a single thread:
+  // the core's own role in Tag mode, the reporter in Perf mode.
+  class LineTable
+  {
+  public:
+    static constexpr uint32_t Slots = 4096;
+
+    struct Entry
+    {
+      std::atomic<uintptr_t> line{0};
+      std::atomic<const char*> name{nullptr};
+      std::atomic<uint64_t> offsets{0};
+      std::atomic<uint64_t> writes{0};
+      std::atomic<uint64_t> hitm{0};
+    };
+
+    void write(const char* name, uintptr_t addr, size_t size)
+    {
+      // a write may straddle two lines
+      uintptr_t end = addr + std::max<size_t>(size, 1);
+      for (uintptr_t line = addr & ~(LineBytes - 1); line < end; line += LineBytes)
+      {
+        Entry* e = find(line, name);
+        if (!e)
+          return;
+
+        uintptr_t from = std::max(addr, line) - line;
+        uintptr_t to = std::min(end, line + LineBytes) - line;
+        uint64_t mask = (to - from == 64) ? ~0ull
+          : ((1ull << (to - from)) - 1) << from;
+
+        bump(e->offsets, e->offsets.load(std::memory_order_relaxed) | mask);
+        bump(e->writes, e->writes.load(std::memory_order_relaxed) + 1);
+      }
+    }
+
+    void hitm(uintptr_t addr)
+    {
+      if (Entry* e = find(addr & ~(LineBytes - 1), nullptr))
+        bump(e->hitm, e->hitm.load(std::memory_order_relaxed) + 1);
+    }
+
+    const Entry& operator[](uint32_t i) const { return entries_[i]; }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  private:
+    static void bump(std::atomic<uint64_t>& a, uint64_t v)
+    {
+      a.store(v, std::memory_order_relaxed);
+    }
+
+    Entry* find(uintptr_t line, const char* name)
+    {
+      uint32_t i = static_cast<uint32_t>((line / LineBytes) * 0x9E3779B1u) % Slots;
+      for (uint32_t probe = 0; probe < Slots; ++probe, i = (i + 1) % Slots)
+      {
+        uintptr_t l = entries_[i].line.load(std::memory_order_relaxed);
+        if (l == line)
+          return &entries_[i];
+        if (l == 0)
+        {
+          entries_[i].name.store(name, std::memory_order_relaxed);
+          entries_[i].line.store(line, std::memory_order_release);
+          return &entries_[i];
+        }
+      }
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+          std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    Entry entries_[Slots];
+    std::atomic<uint64_t> dropped_{0};
+  };
+
+  // Per line view across all cores at one point in time
+  struct LineCounts
+  {
+    const char* name{nullptr};
+    std::map<uint32_t, uint64_t> writes;   // core -> writes
+    std::map<uint32_t, uint64_t> offsets;  // core -> byte mask
+    uint64_t hitm{0};
+  };
+  using Snapshot = std::map<uintptr_t, LineCounts>;
+
+  FalseSharingDetector(uint32_t cores, Mode mode)
+    : mode_(mode)
+    , tables_(std::make_unique<LineTable[]>(cores))
+    , samplers_(cores)
+  {}
+
+  ~FalseSharingDetector()
+  {
+    for (auto& s : samplers_)
+      for (auto& r : s.rings)
+        r.close();
+  }
+
+  Mode mode() const { return mode_; }
+
+  // sample period and raw events for Perf mode, the defaults are the
+  // Intel MEM_INST_RETIRED.ALL_STORES and MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM
+  static uint64_t& period() { static uint64_t p = 10007; return p; }
+  static uint64_t& rawStores() { static uint64_t r = 0x82d0; return r; }
+  static uint64_t& rawHitmLoads() { static uint64_t r = 0x04d2; return r; }
+
+  void registerRange(const std::string& name, const void* p, size_t bytes)
+  {
+    ranges_.push_back({name, reinterpret_cast<uintptr_t>(p), bytes});
+  }
+
+  void tag(uint32_t core, const char* name, const void* addr, size_t size)
+  {
+    tables_[core].write(name, reinterpret_cast<uintptr_t>(addr), size);
+  }
+
+  // Perf mode, start sampling the role with kernel thread id tid
+  bool openSampling(uint32_t core, pid_t tid)
+  {
+    bool stores = samplers_[core].rings[0].open(tid, rawStores());
+    samplers_[core].rings[1].open(tid, rawHitmLoads());
+    return stores;
+  }
+
+  // Perf mode, move pending samples into the line tables
+  void drain()
+  {
+    for (uint32_t core = 0; core < samplers_.size(); ++core)
+    {
+      samplers_[core].rings[0].drain([&](uintptr_t addr)
+          { tables_[core].write(nullptr, addr, 1); });
+      samplers_[core].rings[1].drain([&](uintptr_t addr)
+          { tables_[core].hitm(addr); });
+    }
+  }
+
+  void snapshot(Snapshot& s) const
+  {
+    s.clear();
+    for (uint32_t core = 0; core < samplers_.size(); ++core)
+    {
+      for (uint32_t i = 0; i < LineTable::Slots; ++i)
+      {
+        auto& e = tables_[core][i];
+        uintptr_t line = e.line.load(std::memory_order_acquire);
+        if (!line)
+          continue;
+
+        auto& lc = s[line];
+        if (!lc.name)
+          lc.name = e.name.load(std::memory_order_relaxed);
+        uint64_t w = e.writes.load(std::memory_order_relaxed);
+        if (w)
+        {
+          lc.writes[core] = w;
+          lc.offsets[core] = e.offsets.load(std::memory_order_relaxed);
+        }
+        lc.hitm += e.hitm.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Contention table of the lines more than one core wrote between
+  // base and now, most written first.
+  void report(std::ostream& os, const Snapshot& now, const Snapshot& base) const
+  {
+    struct Row { uintptr_t line; const LineCounts* lc; uint64_t writes; uint64_t hitm;
+      std::map<uint32_t, uint64_t> perCore; };
+    std::vector<Row> rows;
+
+    for (auto& [line, lc] : now)
+    {
+      auto b = base.find(line);
+      Row r{line, &lc, 0, lc.hitm, {}};
+      for (auto& [core, w] : lc.writes)
+      {
+        uint64_t was = 0;
+        if (b != base.end())
+        {
+          auto bw = b->second.writes.find(core);
+          if (bw != b->second.writes.end())
+            was = bw->second;
+        }
+        if (w > was)
+        {
+          r.perCore[core] = w - was;
+          r.writes += w - was;
+        }
+      }
+      if (b != base.end())
+        r.hitm -= std::min(r.hitm, b->second.hitm);
+
+      if (r.perCore.size() > 1)
+        rows.push_back(r);
+    }
+
+    std::sort(rows.begin(), rows.end(),
+        [](const Row& a, const Row& b) { return a.writes > b.writes; });
+
+    os << "False sharing: " << rows.size()
+      << " lines written by more than one core ("
+      << (mode_ == Mode::Perf ? "sampled stores" : "tagged writes")
+      << ")" << std::endl;
+
+    for (auto& r : rows)
+    {
+      if (&r - rows.data() == MaxRows)
+      {
+        os << "  ... " << rows.size() - MaxRows << " more" << std::endl;
+        break;
+      }
+
+      // disjoint bytes per core is false sharing, overlap is true sharing
+      uint64_t seen = 0;
+      bool overlap = false;
+      for (auto& [core, w] : r.perCore)
+      {
+        uint64_t m = r.lc->offsets.at(core);
+        overlap = overlap || (seen & m);
+        seen |= m;
+      }
+
+      os << "  0x" << std::hex << r.line << std::dec
+        << " " << std::left << std::setw(28) << where(r.line, r.lc->name)
+        << std::right << (overlap ? " true sharing " : " FALSE SHARING")
+        << " writes = " << r.writes;
+      if (mode_ == Mode::Perf)
+        os << ", HITM loads = " << r.hitm;
+      os << ", by core:";
+      for (auto& [core, w] : r.perCore)
+        os << " " << core << "(" << w << ", bytes 0x" << std::hex
+          << r.lc->offsets.at(core) << std::dec << ")";
+      os << std::endl;
+    }
+
+    uint64_t dropped{0};
+    for (uint32_t core = 0; core < samplers_.size(); ++core)
+    {
+      dropped += tables_[core].dropped();
+      for (auto& ring : samplers_[core].rings)
+        dropped += ring.lost;
+    }
+    if (dropped)
+      os << "  (" << dropped << " samples lost or lines over table size)" << std::endl;
+  }
+
+private:
+  struct Range
+  {
+    std::string name;
+    uintptr_t begin;
+    size_t bytes;
+  };
+
+  // registered structures (and offsets) on a line, else the tag name
+  std::string where(uintptr_t line, const char* tagName) const
+  {
+    std::string r;
+    for (auto& range : ranges_)
+      if (line + LineBytes > range.begin && line < range.begin + range.bytes)
+      {
+        if (!r.empty())
+          r += "/";
+        if (line < range.begin)
+          r += range.name + "-" + std::to_string(range.begin - line);
+        else
+          r += range.name + "+" + std::to_string(line - range.begin);
+      }
+
+    if (r.empty())
+      return tagName ? tagName : "unregistered";
+    return r;
+  }
+
+  // One sampled event of one role and its perf ring buffer
+  struct Ring
+  {
+    static constexpr size_t DataPages = 128;
+
+    int fd{-1};
+    char* base{nullptr};
+    size_t page{0};
+    uint64_t lost{0};
+
+    bool open(pid_t tid, uint64_t raw)
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_RAW;
+      attr.config = raw;
+      attr.sample_period = period();
+      attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_ADDR;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+
+      // data addresses need a precise (PEBS) event
+      for (int precise = 2; precise > 0 && fd < 0; --precise)
+      {
+        attr.precise_ip = precise;
+        fd = syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+      }
+      if (fd < 0)
+        return false;
+
+      page = sysconf(_SC_PAGESIZE);
+      void* p = mmap(nullptr, (1 + DataPages) * page,
+          PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED)
+      {
+        close();
+        return false;
+      }
+      base = static_cast<char*>(p);
+      return true;
+    }
+
+    void close()
+    {
+      if (base)
+        munmap(base, (1 + DataPages) * page);
+      if (fd >= 0)
+        ::close(fd);
+      base = nullptr;
+      fd = -1;
+    }
+
+    template <typename F>
+    void drain(F f)
+    {
+      if (!base)
+        return;
+
+      auto* meta = reinterpret_cast<perf_event_mmap_page*>(base);
+      const char* data = base + page;
+      const uint64_t size = DataPages * page;
+
+      uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+      uint64_t tail = meta->data_tail;
+
+      // records may wrap around the end of the buffer
+      auto copy = [&](uint64_t pos, void* to, size_t n)
+      {
+        for (size_t i = 0; i < n; ++i)
+          static_cast<char*>(to)[i] = data[(pos + i) % size];
+      };
+
+      while (tail < head)
+      {
+        perf_event_header h;
+        copy(tail, &h, sizeof(h));
+        if (h.size == 0)
+          break;
+
+        if (h.type == PERF_RECORD_SAMPLE)
+        {
+          // PERF_SAMPLE_TID then PERF_SAMPLE_ADDR
+          uint64_t body[2];
+          copy(tail + sizeof(h), body, sizeof(body));
+          if (body[1])
+            f(static_cast<uintptr_t>(body[1]));
+        }
+        else if (h.type == PERF_RECORD_LOST)
+        {
+          // id then lost count
+          uint64_t body[2];
+          copy(tail + sizeof(h), body, sizeof(body));
+          lost += body[1];
+        }
+        tail += h.size;
+      }
+
+      __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+    }
+  };
+
+  struct Sampler
+  {
+    // stores, HITM loads
+    Ring rings[2];
+  };
+
+  Mode mode_;
+  std::unique_ptr<LineTable[]> tables_;
+  std::vector<Sampler> samplers_;
+  std::vector<Range> ranges_;
+};
@@ -0,0 +1,255 @@
+//  flat combining queue from
+//  Hendler, D., Incze, I., Shavit, N. and Tzafrir, M.,
+//  "flat combining and the synchronization-parallelism tradeoff"
+//
+//  Threads do not touch the queue itself. Each posts its push or pop to
+//  its own publication record and spins on it; whichever thread takes the
+//  combiner lock applies every posted operation to a plain sequential
+//  ring and writes back the results. The ring, its indices and the lock
+//  stay in the combiner's cache, the only lines that move between cores
+//  are the records and the lock.
+
+#ifndef BOOST_FC_QUEUE_HPP_INCLUDED
+#define BOOST_FC_QUEUE_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <type_traits>
+
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/has_trivial_assign.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <boost/config.hpp> // for BOOST_LIKELY
+
+#include <boost/lockfree/detail/copy_payload.hpp>
+#include <boost/lockfree/detail/parameter.hpp>
+
+#include "queue_hooks.h"
+
+namespace boost    {
+namespace lockfree {
+
+/** The queue class provides a multi-writer/multi-reader queue, every
+ *  operation is applied by a combining thread under one lock.
+ *
+ *  With boost::lockfree::capacity<> the ring is stored inside the queue
+ *  object (so it can be placed in shared memory) and push() fails when it
+ *  is full, otherwise the ring starts at n slots and the combiner doubles
+ *  it when full. At most max_threads threads use one queue.
+ * */
+template <typename T, typename ...Options>
+class fcqueue
+{
+private:
+    BOOST_STATIC_ASSERT((boost::has_trivial_destructor<T>::value));
+    BOOST_STATIC_ASSERT((boost::has_trivial_assign<T>::value));
+
+    typedef typename boost::parameter::parameters<boost::parameter::optional<tag::allocator>,
+                                                  boost::parameter::optional<tag::capacity>
+                                                 >::template bind<Options...>::type bound_args;
+
+    static const bool has_capacity = detail::extract_capacity<bound_args>::has_capacity;
+    static const size_t capacity = detail::extract_capacity<bound_args>::capacity;
+
+    typedef ::bandwidth::QueueCounters counters;
+
+    enum operation : std::uint32_t { op_none, op_push, op_pop, op_done };
+
+    struct BOOST_ALIGNMENT(64) record
+    {
+        std::atomic<std::uint32_t> op{op_none};
+        bool result{false};
+        T data;
+    };
+
+    struct inline_ring
+    {
+        inline_ring(size_t) {}
+        T * get() { return slots; }
+        size_t size() const { return capacity; }
+        bool grow(size_t, size_t) { return false; }
+        T slots[capacity];
+    };
+
+    struct allocated_ring
+    {
+        allocated_ring(size_t n) : slots(new T[n]), n_(n) {}
+        T * get() { return slots.get(); }
+        size_t size() const { return n_; }
+
+        // the count elements from first, unwrapped to the new start
+        bool grow(size_t first, size_t count)
+        {
+            std::unique_ptr<T[]> bigger(new T[n_ * 2]);
+            for (size_t i = 0; i < count; ++i)
+                bigger[i] = slots[(first + i) % n_];
+            slots = std::move(bigger);
+            n_ *= 2;
+            return true;
+        }
+
+        std::unique_ptr<T[]> slots;
+        size_t n_;
+    };
+
+    typedef typename std::conditional<has_capacity, inline_ring, allocated_ring>::type storage;
+
+    BOOST_DELETED_FUNCTION(fcqueue(fcqueue const&))
+    BOOST_DELETED_FUNCTION(fcqueue& operator= (fcqueue const&))
+
+public:
+    typedef T value_type;
+
+    static constexpr std::uint32_t max_threads = 256;
+
+    // a ring slot, the records are per thread not per message
+    static const size_t node_bytes = sizeof(T);
+
+    //! Construct queue with a ring of capacity<> slots
+    fcqueue(void):
+        ring_(capacity)
+    {
+        BOOST_STATIC_ASSERT(has_capacity);
+    }
+
+    //! Construct queue with a ring of n slots, grown when full
+    explicit fcqueue(size_t n):
+        ring_((std::max)(n, size_t(1)))
+    {
+        BOOST_STATIC_ASSERT(!has_capacity);
+    }
+
+    bool push(T const & t)
+    {
+        record & r = own_record();
+        ::bandwidth::tagWrite("queue fc record", &r, sizeof(r));
+        r.data = t;
+        if (apply(r, op_push))
+            return true;
+
+        ::bandwidth::count(counters::FailedPushes);
+        return false;
+    }
+
+    template <typename U>
+    bool pop(U & ret)
+    {
+        record & r = own_record();
+        if (apply(r, op_pop)) {
+            detail::copy_payload(r.data, ret);
+            return true;
+        }
+
+        ::bandwidth::count(counters::EmptyPops);
+        return false;
+    }
+
+private:
+    // Posts op and waits for a combiner, possibly this thread, to apply it
+    bool apply(record & r, operation op)
+    {
+        ::bandwidth::tagWrite("queue fc record", &r.op, sizeof(r.op));
+        r.op.store(op, std::memory_order_release);
+
+        for (;;) {
+            if (r.op.load(std::memory_order_acquire) == op_done)
+                break;
+
+            if (lock_.load(std::memory_order_relaxed) == 0) {
+                ::bandwidth::tagWrite("queue fc lock", &lock_, sizeof(lock_));
+                if (lock_.exchange(1, std::memory_order_acquire) == 0) {
+                    combine();
+                    lock_.store(0, std::memory_order_release);
+                    continue;
+                }
+            }
+            __builtin_ia32_pause();
+        }
+
+        r.op.store(op_none, std::memory_order_relaxed);
+        return r.result;
+    }
+
+    // one pass over every claimed record, under the lock
+    void combine(void)
+    {
+        std::uint32_t records = (std::min)(claimed_.load(std::memory_order_acquire), max_threads);
+        std::uint32_t applied = 0;
+        for (std::uint32_t i = 0; i < records; ++i) {
+            record & r = records_[i];
+            std::uint32_t op = r.op.load(std::memory_order_acquire);
+            if (op != op_push && op != op_pop)
+                continue;
+
+            ::bandwidth::tagWrite("queue fc record", &r, sizeof(r));
+            r.result = op == op_push ? ring_push(r.data) : ring_pop(r.data);
+            r.op.store(op_done, std::memory_order_release);
+            ++applied;
+        }
+
+        ::bandwidth::count(counters::CombinerPasses);
+        ::bandwidth::count(counters::CombinedOps, applied);
+    }
+
+    bool ring_push(T const & t)
+    {
+        if (count_ == ring_.size()) {
+            if (!ring_.grow(first_, count_))
+                return false;
+            first_ = 0;
+        }
+
+        T & slot = ring_.get()[(first_ + count_) % ring_.size()];
+        ::bandwidth::tagWrite("queue fc ring", &slot, sizeof(T));
+        slot = t;
+        ++count_;
+        return true;
+    }
+
+    bool ring_pop(T & t)
+    {
+        if (count_ == 0)
+            return false;
+
+        t = ring_.get()[first_];
+        first_ = (first_ + 1) % ring_.size();
+        --count_;
+        return true;
+    }
+
+    // claimed once per thread, a thread serves one queue at a time
+    record & own_record(void)
+    {
+        struct claim
+        {
+            fcqueue * owner{nullptr};
+            std::uint32_t index{0};
+        };
+        thread_local claim t_claim;
+
+        if (BOOST_UNLIKELY(t_claim.owner != this)) {
+            t_claim.index = claimed_.fetch_add(1);
+            if (t_claim.index >= max_threads)
+                std::abort();
+            t_claim.owner = this;
+        }
+        return records_[t_claim.index];
+    }
+
+    // the combiner's
+    alignas(64) std::atomic<std::uint32_t> lock_{0};
+    size_t first_{0};
+    size_t count_{0};
+    storage ring_;
+
+    alignas(64) std::atomic<std::uint32_t> claimed_{0};
+    record records_[max_threads];
+};
+
+} /* namespace lockfree */
+} /* namespace boost */
+
+#endif /* BOOST_FC_QUEUE_HPP_INCLUDED */
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <type_traits>
+
+#include <boost/lockfree/queue.hpp>
+
+// Memory a queue type costs. Every queue here is node based: one node
+// per message in flight plus a dummy node, taken from a pool reserved
+// up front (grown on demand by the unbounded ones). A queue of several
+// lanes reserves node_pools of them.
+template <typename Q>
+struct QueueFootprint
+{
+  static constexpr size_t nodeBytes = Q::node_bytes;
+  static constexpr size_t nodePools = [] {
+    if constexpr (requires { Q::node_pools; })
+      return Q::node_pools;
+    else
+      return size_t{1};
+  }();
+};
+
+// boost::lockfree::queue keeps its node private, this mirrors it: a
+// cache line aligned tagged link (pointer, or index when the capacity
+// is fixed at compile time) followed by the payload.
+template <typename T, typename... Options>
+struct QueueFootprint<boost::lockfree::queue<T, Options...>>
+{
+  using bound = typename boost::lockfree::detail::queue_signature::
+    template bind<Options...>::type;
+  static constexpr bool indexed =
+    boost::lockfree::detail::extract_capacity<bound>::has_capacity;
+
+  struct BOOST_ALIGNMENT(BOOST_LOCKFREE_CACHELINE_BYTES) node
+  {
+    typename std::conditional<indexed
+      , boost::lockfree::detail::tagged_index
+      , boost::lockfree::detail::tagged_ptr<node>>::type next;
+    T data;
+  };
+
+  static constexpr size_t nodeBytes = sizeof(node);
+  static constexpr size_t nodePools = 1;
+};
+
+// One line per queue type: object, node and pool bytes, and the cost
+// of each message in flight when all reserved nodes are in use.
+template <typename Q, typename T>
+void reportFootprint(std::ostream& os, const char* name, size_t nodes)
+{
+  size_t node = QueueFootprint<Q>::nodeBytes;
+  size_t pools = QueueFootprint<Q>::nodePools;
+  size_t pool = node * (nodes + 1) * pools;
+  // fixed capacity queues hold their nodes inside the object
+  size_t total = sizeof(Q) >= pool ? sizeof(Q) : sizeof(Q) + pool;
+
+  os << std::left << std::setw(28) << name << std::right
+    << " payload " << std::setw(4) << sizeof(T)
+    << ", queue " << std::setw(6) << sizeof(Q)
+    << ", node " << std::setw(4) << node
+    << ", pool " << std::setw(7) << pool
+    << " (" << nodes << " + 1 nodes";
+  if (pools > 1)
+    os << " x " << pools;
+  os << ")"
+    << ", per message in flight " << node
+    << " (" << std::setw(6) << total / static_cast<double>(nodes)
+    << " with the queue and pool)"
+    << ", payload share " << std::setprecision(3)
+    << static_cast<double>(sizeof(T)) / node
+    << std::setprecision(6) << std::endl;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Log-linear latency histogram in TSC cycles, 2^SubBits linear buckets per
+// power of two (relative error < 1/2^SubBits).
+//
+// Single writer: the owning thread records with relaxed load/store so no
+// locked instruction is added to the consumer path. Readers take a
+// Snapshot of the running counts, an interval is the difference of two
+// snapshots. A snapshot's total is the sum of the counts it read, so
+// it stays consistent with them while the owner keeps recording.
+class LatencyHistogram
+{
+public:
+  static constexpr uint32_t SubBits = 5;
+  static constexpr uint32_t SubBuckets = 1 << SubBits;
+  static constexpr uint32_t Buckets = (64 - SubBits + 1) * SubBuckets;
+
+  struct Snapshot
+  {
+    uint64_t counts[Buckets];
+    uint64_t total{0};
+
+    Snapshot() { std::memset(counts, 0, sizeof(counts)); }
+
+    Snapshot& operator-=(const Snapshot& rhs)
+    {
+      for (uint32_t i = 0; i < Buckets; ++i)
+        counts[i] -= rhs.counts[i];
+      total -= rhs.total;
+      return *this;
+    }
+
+    Snapshot& operator+=(const Snapshot& rhs)
+    {
+      for (uint32_t i = 0; i < Buckets; ++i)
+        counts[i] += rhs.counts[i];
+      total += rhs.total;
+      return *this;
+    }
+
+    // upper bound in cycles of the bucket holding quantile q (0..1)
+    uint64_t percentile(double q) const
+    {
+      if (!total)
+        return 0;
+
+      uint64_t rank = static_cast<uint64_t>(q * total);
+      if (rank >= total)
+        rank = total - 1;
+
+      uint64_t seen{0};
+      for (uint32_t i = 0; i < Buckets; ++i)
+      {
+        seen += counts[i];
+        if (seen > rank)
+          return upperBound(i);
+      }
+      return upperBound(Buckets - 1);
+    }
+
+    uint64_t max() const
+    {
+      for (uint32_t i = Buckets; i > 0; --i)
+        if (counts[i - 1])
+          return upperBound(i - 1);
+      return 0;
+    }
+  };
+
+  LatencyHistogram()
+  {
+    for (auto& c : counts_)
+      c.store(0, std::memory_order_relaxed);
+  }
+
+  void record(uint64_t cycles)
+  {
+    auto& c = counts_[bucket(cycles)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  void snapshot(Snapshot& s) const
+  {
+    s.total = 0;
+    for (uint32_t i = 0; i < Buckets; ++i)
+    {
+      s.counts[i] = counts_[i].load(std::memory_order_relaxed);
+      s.total += s.counts[i];
+    }
+  }
+
+  static uint32_t bucket(uint64_t v)
+  {
+    if (v < SubBuckets)
+      return static_cast<uint32_t>(v);
+
+    uint32_t e = 63 - __builtin_clzll(v);
+    uint32_t shift = e - SubBits;
+    return (shift + 1) * SubBuckets
+      + static_cast<uint32_t>((v >> shift) - SubBuckets);
+  }
+
+  static uint64_t upperBound(uint32_t b)
+  {
+    if (b < SubBuckets)
+      return b;
+
+    uint32_t shift = b / SubBuckets - 1;
+    uint64_t m = b % SubBuckets + SubBuckets;
+    return ((m + 1) << shift) - 1;
+  }
+
+private:
+  std::atomic<uint64_t> counts_[Buckets];
+};
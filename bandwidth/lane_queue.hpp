@@ -0,0 +1,173 @@
+//  multi-lane priority queue
+//
+//  K gqueue lanes behind one push/pop. A producer tags the lane of each
+//  message, a consumer serves the lanes either in strict priority (lane
+//  0 first, a lower lane only when every higher one is empty) or in
+//  weighted round robin (up to weight[l] messages from lane l before it
+//  moves on, an empty lane gives up its turn). Lane 0 is the highest
+//  priority.
+//
+//  The lane travels beside the message, not in it: push() takes the
+//  calling thread's bandwidth::t_pushLane and pop() leaves the lane it
+//  served in bandwidth::t_popLane, so T and the other queues are
+//  unchanged.
+
+#ifndef BOOST_LANE_QUEUE_HPP_INCLUDED
+#define BOOST_LANE_QUEUE_HPP_INCLUDED
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include <boost/config.hpp> // for BOOST_LIKELY
+
+#include "boost_queue.hpp"
+#include "queue_hooks.h"
+
+namespace bandwidth
+{
+  static constexpr uint32_t MaxLanes = 8;
+
+  enum class LaneService { Strict, Weighted };
+
+  // read by each lanequeue when it is constructed
+  inline uint32_t g_lanes = 2;
+  inline LaneService g_laneService = LaneService::Strict;
+  inline uint32_t g_laneWeights[MaxLanes] = { 1, 1, 1, 1, 1, 1, 1, 1 };
+
+  // lane of the calling producer's next push, and of the consumer's
+  // last successful pop
+  inline thread_local uint32_t t_pushLane = 0;
+  inline thread_local uint32_t t_popLane = 0;
+}
+
+namespace boost    {
+namespace lockfree {
+
+/** The queue class provides a multi-writer/multi-reader queue of
+ *  bandwidth::g_lanes gqueue lanes, served as bandwidth::g_laneService.
+ *
+ *  Options are passed on to every lane: with boost::lockfree::capacity<>
+ *  each lane holds that many nodes inside the object, otherwise each
+ *  lane reserves n nodes.
+ * */
+template <typename T, typename ...Options>
+class lanequeue
+{
+private:
+    typedef gqueue<T, Options...> lane_type;
+    static constexpr std::uint32_t max_lanes = ::bandwidth::MaxLanes;
+
+    // weighted round robin position of one consumer thread
+    struct service
+    {
+        lanequeue const * owner{nullptr};
+        std::uint32_t lane{0};
+        std::uint32_t credit{0};
+    };
+
+    template <std::size_t ...I>
+    lanequeue(size_t n, std::index_sequence<I...>):
+        lanes_{ ((void)I, lane_type(n))... }
+    {
+        initialize();
+    }
+
+    BOOST_DELETED_FUNCTION(lanequeue(lanequeue const&))
+    BOOST_DELETED_FUNCTION(lanequeue& operator= (lanequeue const&))
+
+public:
+    typedef T value_type;
+
+    // every lane keeps its own pool of these
+    static const size_t node_bytes = lane_type::node_bytes;
+    static constexpr size_t node_pools = max_lanes;
+
+    //! Construct queue, capacity<> nodes per lane
+    lanequeue(void)
+    {
+        initialize();
+    }
+
+    //! Construct queue, allocate n nodes per lane
+    explicit lanequeue(size_t n):
+        lanequeue(n, std::make_index_sequence<max_lanes>())
+    {}
+
+    std::uint32_t lanes(void) const { return lane_count; }
+
+    //! Calls f(begin, bytes) for the nodes of every lane, used or not
+    template <typename F>
+    void for_each_node_block(F && f) const
+    {
+        for (std::uint32_t lane = 0; lane < max_lanes; ++lane)
+            lanes_[lane].for_each_node_block(f);
+    }
+
+    //! Pushes t to lane bandwidth::t_pushLane, the last lane if beyond it
+    bool push(T const & t)
+    {
+        std::uint32_t lane = (std::min)(::bandwidth::t_pushLane, lane_count - 1);
+        return lanes_[lane].push(t);
+    }
+
+    //! Sets bandwidth::t_popLane to the lane served
+    template <typename U>
+    bool pop(U & ret)
+    {
+        if (service_ == ::bandwidth::LaneService::Strict) {
+            for (std::uint32_t lane = 0; lane < lane_count; ++lane) {
+                if (lanes_[lane].pop(ret)) {
+                    ::bandwidth::t_popLane = lane;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        service & s = own_service();
+        // the current lane, if it has credit left, then each lane once
+        for (std::uint32_t i = 0; i <= lane_count; ++i) {
+            if (s.credit && lanes_[s.lane].pop(ret)) {
+                --s.credit;
+                ::bandwidth::t_popLane = s.lane;
+                return true;
+            }
+            s.lane = s.lane + 1 == lane_count ? 0 : s.lane + 1;
+            s.credit = weights_[s.lane];
+        }
+        return false;
+    }
+
+private:
+    void initialize(void)
+    {
+        lane_count = (std::max)(std::uint32_t(1), (std::min)(::bandwidth::g_lanes, max_lanes));
+        service_ = ::bandwidth::g_laneService;
+        for (std::uint32_t lane = 0; lane < max_lanes; ++lane)
+            weights_[lane] = (std::max)(std::uint32_t(1), ::bandwidth::g_laneWeights[lane]);
+    }
+
+    // per thread, a thread consumes from one queue at a time
+    service & own_service(void)
+    {
+        thread_local service t_service;
+        if (BOOST_UNLIKELY(t_service.owner != this)) {
+            t_service = service();
+            t_service.owner = this;
+            t_service.credit = weights_[0];
+        }
+        return t_service;
+    }
+
+    std::uint32_t lane_count;
+    ::bandwidth::LaneService service_;
+    std::uint32_t weights_[max_lanes];
+
+    lane_type lanes_[max_lanes];
+};
+
+} /* namespace lockfree */
+} /* namespace boost */
+
+#endif /* BOOST_LANE_QUEUE_HPP_INCLUDED */
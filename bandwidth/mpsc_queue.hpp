@@ -0,0 +1,253 @@
+//  multi-producer/single-consumer queue after
+//  Vyukov, D., "intrusive MPSC node-based queue"
+//
+//  A producer links its node with one exchange on the tail and a store
+//  to the old tail's next, it never retries. The single consumer owns
+//  head_ and pops with plain loads and stores. Nodes live in one fixed
+//  array linked by 32 bit indices; producers take them from a tagged
+//  freelist, the consumer hands them back in chains of free_batch with
+//  one CAS each.
+//
+//  A producer preempted between its exchange and its link hides every
+//  later node from the consumer until it resumes, pop() reports empty.
+
+#ifndef BOOST_MPSC_FIFO_HPP_INCLUDED
+#define BOOST_MPSC_FIFO_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include <boost/assert.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/has_trivial_assign.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <boost/config.hpp> // for BOOST_LIKELY
+
+#include <boost/lockfree/detail/parameter.hpp>
+
+#include "queue_hooks.h"
+
+namespace boost    {
+namespace lockfree {
+
+/** The queue class provides a multi-writer/single-reader queue over a
+ *  fixed number of nodes. pop() must only ever be called by one thread
+ *  at a time.
+ *
+ *  With boost::lockfree::capacity<> the nodes are stored inside the queue
+ *  object (so it can be placed in shared memory), otherwise n + 1 nodes
+ *  are allocated by the constructor. push() fails when all nodes are in
+ *  use, the queue never allocates after construction.
+ * */
+template <typename T, typename ...Options>
+class mpscqueue
+{
+private:
+    BOOST_STATIC_ASSERT((boost::has_trivial_destructor<T>::value));
+    BOOST_STATIC_ASSERT((boost::has_trivial_assign<T>::value));
+
+    typedef typename boost::parameter::parameters<boost::parameter::optional<tag::allocator>,
+                                                  boost::parameter::optional<tag::capacity>
+                                                 >::template bind<Options...>::type bound_args;
+
+    static const bool has_capacity = detail::extract_capacity<bound_args>::has_capacity;
+    static const size_t capacity = detail::extract_capacity<bound_args>::capacity + 1; // the queue uses one dummy node
+
+    typedef std::uint64_t tagged_index;
+    typedef ::bandwidth::QueueCounters counters;
+    static const std::uint32_t null_index = 0xffffffff;
+    static const std::uint32_t max_free_batch = 32;
+
+    static std::uint32_t index(tagged_index t) { return static_cast<std::uint32_t>(t); }
+    static std::uint32_t tag(tagged_index t) { return static_cast<std::uint32_t>(t >> 32); }
+    static tagged_index make(std::uint32_t i, std::uint32_t t)
+    {
+        return (static_cast<tagged_index>(t) << 32) | i;
+    }
+
+    struct node
+    {
+        // queue link, or freelist link while the node is free
+        std::atomic<std::uint32_t> next;
+        T data;
+    };
+
+    struct inline_nodes
+    {
+        inline_nodes(size_t) {}
+        node * get() { return nodes; }
+        node nodes[capacity];
+    };
+
+    struct allocated_nodes
+    {
+        allocated_nodes(size_t n) : nodes(new node[n]) {}
+        node * get() { return nodes.get(); }
+        std::unique_ptr<node[]> nodes;
+    };
+
+    typedef typename std::conditional<has_capacity, inline_nodes, allocated_nodes>::type storage;
+
+    BOOST_DELETED_FUNCTION(mpscqueue(mpscqueue const&))
+    BOOST_DELETED_FUNCTION(mpscqueue& operator= (mpscqueue const&))
+
+public:
+    typedef T value_type;
+
+    static const size_t node_bytes = sizeof(node);
+
+    //! Construct queue with capacity<> nodes
+    mpscqueue(void):
+        node_count(capacity),
+        storage_(capacity)
+    {
+        BOOST_STATIC_ASSERT(has_capacity);
+        initialize();
+    }
+
+    //! Construct queue, allocate n nodes
+    explicit mpscqueue(size_t n):
+        node_count(n + 1),
+        storage_(n + 1)
+    {
+        BOOST_STATIC_ASSERT(!has_capacity);
+        initialize();
+    }
+
+    size_t nodes(void) const { return node_count; }
+
+    //! Calls f(begin, bytes) for the nodes allocated by the constructor
+    template <typename F>
+    void for_each_node_block(F && f)
+    {
+        if (!has_capacity)
+            f(storage_.get(), node_count * sizeof(node));
+    }
+
+    bool push(T const & t)
+    {
+        std::uint32_t n = allocate();
+        if (n == null_index) {
+            ::bandwidth::count(counters::FailedPushes);
+            return false;
+        }
+
+        node & nn = at(n);
+        ::bandwidth::tagWrite("queue node", &nn, sizeof(node));
+        nn.data = t;
+        nn.next.store(null_index, std::memory_order_relaxed);
+
+        ::bandwidth::tagWrite("queue tail", &tail_, sizeof(tail_));
+        std::uint32_t prev = tail_.exchange(n, std::memory_order_acq_rel);
+
+        node & prev_node = at(prev);
+        ::bandwidth::tagWrite("queue node next", &prev_node.next, sizeof(prev_node.next));
+        prev_node.next.store(n, std::memory_order_release);
+        return true;
+    }
+
+    //! Single consumer only
+    bool pop(T & ret)
+    {
+        std::uint32_t next = at(head_).next.load(std::memory_order_acquire);
+        if (next == null_index) {
+            // idle, hand back what the producers may be waiting for
+            flush();
+            ::bandwidth::count(counters::EmptyPops);
+            return false;
+        }
+
+        ret = at(next).data;
+        deallocate(head_);
+        head_ = next;
+        return true;
+    }
+
+private:
+    node & at(std::uint32_t i) { return storage_.get()[i]; }
+
+    void initialize(void)
+    {
+        BOOST_ASSERT(node_count < null_index);
+
+        // node 0 is the dummy, the rest start on the freelist
+        at(0).next.store(null_index, std::memory_order_relaxed);
+        for (std::uint32_t i = 1; i < node_count; ++i)
+            at(i).next.store(i + 1 < node_count ? i + 1 : null_index,
+                    std::memory_order_relaxed);
+
+        free_batch = static_cast<std::uint32_t>(
+                (std::min)(size_t(max_free_batch), (std::max)(node_count / 4, size_t(1))));
+        free_.store(make(node_count > 1 ? 1 : null_index, 0), std::memory_order_relaxed);
+        head_ = 0;
+        tail_.store(0, std::memory_order_release);
+    }
+
+    std::uint32_t allocate(void)
+    {
+        for (;;) {
+            tagged_index f = free_.load(std::memory_order_acquire);
+            if (index(f) == null_index)
+                return null_index;
+
+            std::uint32_t next = at(index(f)).next.load(std::memory_order_relaxed);
+            ::bandwidth::tagWrite("queue freelist", &free_, sizeof(free_));
+            if (::bandwidth::countCas(counters::FreelistCas,
+                        free_.compare_exchange_weak(f, make(next, tag(f) + 1))))
+                return index(f);
+        }
+    }
+
+    // consumer side, chained privately until a batch is complete
+    void deallocate(std::uint32_t n)
+    {
+        at(n).next.store(chain_first, std::memory_order_relaxed);
+        if (chain_first == null_index)
+            chain_last = n;
+        chain_first = n;
+        if (++chain_length == free_batch)
+            flush();
+    }
+
+    void flush(void)
+    {
+        if (chain_first == null_index)
+            return;
+
+        node & last = at(chain_last);
+        for (;;) {
+            tagged_index f = free_.load(std::memory_order_acquire);
+            ::bandwidth::tagWrite("queue node", &last.next, sizeof(last.next));
+            last.next.store(index(f), std::memory_order_relaxed);
+
+            ::bandwidth::tagWrite("queue freelist", &free_, sizeof(free_));
+            if (::bandwidth::countCas(counters::FreelistCas,
+                        free_.compare_exchange_weak(f, make(chain_first, tag(f) + 1))))
+                break;
+        }
+        chain_first = null_index;
+        chain_length = 0;
+    }
+
+    // the consumer's
+    alignas(64) std::uint32_t head_;
+    std::uint32_t chain_first{null_index};
+    std::uint32_t chain_last{null_index};
+    std::uint32_t chain_length{0};
+    std::uint32_t free_batch;
+
+    // the producers', each on its own cache line
+    alignas(64) std::atomic<std::uint32_t> tail_;
+    alignas(64) std::atomic<tagged_index> free_;
+    size_t node_count;
+
+    alignas(64) storage storage_;
+};
+
+} /* namespace lockfree */
+} /* namespace boost */
+
+#endif /* BOOST_MPSC_FIFO_HPP_INCLUDED */
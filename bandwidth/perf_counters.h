@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Hardware counters of one thread (or single threaded process) as a
+// perf_event_open group, so all events cover the same instructions.
+//
+// The group is opened for a tid from outside the thread, any thread of
+// the opening process can read it. Events the kernel or the cpu refuse
+// are left out of the group and reported as not valid; if the whole
+// group cannot be opened every event is not valid.
+//
+// HITM and snoop are model specific raw events. The defaults are the
+// Intel (Skylake and later) MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM and
+// .XSNP_HIT, loads that hit a line modified, or present, in another
+// core's private cache: false sharing shows up directly in HITM. Other
+// vendors get no default and need hitm=/snoop= on the command line.
+class PerfGroup
+{
+public:
+  enum Event : uint32_t
+  {
+      Cycles
+    , Instructions
+    , L1DMisses
+    , LLCMisses
+    , Hitm
+    , Snoop
+    , Events
+  };
+
+  struct Counts
+  {
+    uint64_t value[Events]{};
+    bool valid[Events]{};
+
+    Counts& operator-=(const Counts& rhs)
+    {
+      for (uint32_t e = 0; e < Events; ++e)
+      {
+        value[e] -= rhs.value[e];
+        valid[e] = valid[e] && rhs.valid[e];
+      }
+      return *this;
+    }
+  };
+
+  static const char* name(uint32_t e)
+  {
+    static const char* names[Events] =
+      { "cycles", "instructions", "L1D misses", "LLC misses", "HITM", "snoop" };
+    return names[e];
+  }
+
+  // raw configs for Hitm and Snoop, 0 leaves the event out
+  static uint64_t& rawHitm() { static uint64_t r = intel() ? 0x04d2 : 0; return r; }
+  static uint64_t& rawSnoop() { static uint64_t r = intel() ? 0x02d2 : 0; return r; }
+
+  PerfGroup() { for (auto& f : fd_) f = -1; }
+  PerfGroup(const PerfGroup&) = delete;
+  PerfGroup& operator=(const PerfGroup&) = delete;
+  ~PerfGroup() { close(); }
+
+  bool open(pid_t tid)
+  {
+    for (uint32_t e = 0; e < Events; ++e)
+    {
+      perf_event_attr attr;
+      if (!config(e, attr))
+        continue;
+
+      int fd = syscall(__NR_perf_event_open, &attr, tid, -1, leader(), 0);
+      if (fd < 0)
+        continue;
+
+      fd_[e] = fd;
+      ioctl(fd, PERF_EVENT_IOC_ID, &id_[e]);
+    }
+    return leader() >= 0;
+  }
+
+  void close()
+  {
+    for (auto& f : fd_)
+    {
+      if (f >= 0)
+        ::close(f);
+      f = -1;
+    }
+  }
+
+  bool read(Counts& c) const
+  {
+    c = Counts();
+    if (leader() < 0)
+      return false;
+
+    // nr, time enabled, time running, { value, id } * nr
+    uint64_t buf[3 + 2 * Events];
+    if (::read(leader(), buf, sizeof(buf)) <= 0)
+      return false;
+
+    uint64_t nr = buf[0], enabled = buf[1], running = buf[2];
+    if (!running)
+      return false;
+
+    for (uint64_t i = 0; i < nr; ++i)
+    {
+      uint64_t value = buf[3 + 2 * i];
+      uint64_t id = buf[4 + 2 * i];
+
+      // scale if the group was multiplexed with other users
+      if (running < enabled)
+        value = static_cast<uint64_t>(
+            static_cast<double>(value) * enabled / running);
+
+      for (uint32_t e = 0; e < Events; ++e)
+      {
+        if (fd_[e] >= 0 && id_[e] == id)
+        {
+          c.value[e] = value;
+          c.valid[e] = true;
+        }
+      }
+    }
+    return true;
+  }
+
+private:
+  int leader() const
+  {
+    for (auto f : fd_)
+      if (f >= 0)
+        return f;
+    return -1;
+  }
+
+  static bool config(uint32_t e, perf_event_attr& attr)
+  {
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID
+      | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (e)
+    {
+      case Cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        return true;
+      case Instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        return true;
+      case L1DMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D
+          | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        return true;
+      case LLCMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        return true;
+      case Hitm:
+        attr.type = PERF_TYPE_RAW;
+        attr.config = rawHitm();
+        return attr.config != 0;
+      case Snoop:
+        attr.type = PERF_TYPE_RAW;
+        attr.config = rawSnoop();
+        return attr.config != 0;
+    }
+    return false;
+  }
+
+  static bool intel()
+  {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+      if (line.find("vendor_id") == 0)
+        return line.find("GenuineIntel") != std::string::npos;
+    return false;
+  }
+
+  int fd_[Events];
+  uint64_t id_[Events]{};
+};
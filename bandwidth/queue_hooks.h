@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/config.hpp>
+
+// Diagnostic hooks called from inside the queue implementations in this
+// directory. They cost one load and a predictable branch while unset.
+namespace bandwidth
+{
+  // Instrumented write tagging: every write site reports the address
+  // and size it is about to modify, see false_sharing.h
+  using TagWriteFn = void (*)(const char* name, const void* addr, size_t size);
+  inline TagWriteFn g_tagWrite = nullptr;
+
+  inline void tagWrite(const char* name, const void* addr, size_t size)
+  {
+    if (BOOST_UNLIKELY(g_tagWrite != nullptr))
+      g_tagWrite(name, addr, size);
+  }
+
+  // Per thread counts of queue internals on their own cache line,
+  // written by the owning thread only (relaxed load/store), read by
+  // the reporter as running totals.
+  struct alignas(64) QueueCounters
+  {
+    // every CAS attempt counter is followed by its failure counter
+    enum Counter : uint32_t
+    {
+        FreelistCas
+      , FreelistCasFailed
+      , HeadCas
+      , HeadCasFailed
+      , TailCas
+      , TailCasFailed
+      , EmptyPops
+      , FailedPushes
+      , Eliminations
+      , BackoffPauses
+      , CombinerPasses
+      , CombinedOps
+      , BurntSlots
+      , RingBatches
+      , CacheRefills
+      , CacheFlushes
+      , Counters
+    };
+
+    // totals of any number of threads
+    struct Snapshot
+    {
+      uint64_t value[Counters]{};
+
+      Snapshot& operator+=(const Snapshot& rhs)
+      {
+        for (uint32_t i = 0; i < Counters; ++i)
+          value[i] += rhs.value[i];
+        return *this;
+      }
+
+      Snapshot& operator-=(const Snapshot& rhs)
+      {
+        for (uint32_t i = 0; i < Counters; ++i)
+          value[i] -= rhs.value[i];
+        return *this;
+      }
+    };
+
+    std::atomic<uint64_t> value[Counters]{};
+
+    void bump(Counter c, uint64_t v = 1)
+    {
+      value[c].store(value[c].load(std::memory_order_relaxed) + v,
+          std::memory_order_relaxed);
+    }
+
+    void snapshot(Snapshot& s) const
+    {
+      for (uint32_t i = 0; i < Counters; ++i)
+        s.value[i] = value[i].load(std::memory_order_relaxed);
+    }
+  };
+
+  // set by each role thread to its own counters
+  inline thread_local QueueCounters* t_queueCounters = nullptr;
+
+  inline void count(QueueCounters::Counter c, uint64_t v = 1)
+  {
+    if (BOOST_UNLIKELY(t_queueCounters != nullptr))
+      t_queueCounters->bump(c, v);
+  }
+
+  // counts a CAS attempt, and its failure, returns its result
+  inline bool countCas(QueueCounters::Counter attempts, bool ok)
+  {
+    if (BOOST_UNLIKELY(t_queueCounters != nullptr))
+    {
+      t_queueCounters->bump(attempts);
+      if (!ok)
+        t_queueCounters->bump(static_cast<QueueCounters::Counter>(attempts + 1));
+    }
+    return ok;
+  }
+
+  // Nodes per batch of gqueue's per thread node cache, 0 takes every
+  // node from and returns it to the shared freelist
+  inline uint32_t g_nodeCacheBatch = 0;
+
+  // gqueue's pop checks for an empty queue with plain loads of head_
+  // and its node before the full pop, and prefetches the node after
+  // the one it took
+  inline bool g_popPeek = false;
+  inline bool g_popPrefetch = false;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+// N words published RCU style by a single writer.
+//
+// The writer fills a free preallocated version and swaps the current
+// pointer to it, readers copy from whatever version is current with no
+// retry. A replaced version is retired at the epoch of the swap and
+// reused once every reader has announced a quiescent state (holding no
+// version) at that epoch or later: epoch based reclamation where the
+// quiescent states are the readers' own checkpoints.
+//
+// At most MaxReaders reader threads, each registers once.
+template <uint32_t N, uint32_t Versions, uint32_t MaxReaders>
+class RcuPublisher
+{
+public:
+  static constexpr size_t LineBytes = 64;
+
+  RcuPublisher()
+  {
+    current_.store(&versions_[0], std::memory_order_relaxed);
+  }
+
+  uint32_t registerReader()
+  {
+    uint32_t r = readers_.fetch_add(1);
+    if (r >= MaxReaders)
+      std::abort();
+    quiescent_[r].epoch.store(epoch_.load());
+    return r;
+  }
+
+  // the reader holds no version
+  void quiescent(uint32_t reader)
+  {
+    quiescent_[reader].epoch.store(
+        epoch_.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  void read(uint32_t* out) const
+  {
+    const Version* v = current_.load(std::memory_order_acquire);
+    std::memcpy(out, v->data, sizeof(v->data));
+  }
+
+  // Single writer. False, and nothing published, while every other
+  // version may still be read.
+  bool tryPublish(const uint32_t* data)
+  {
+    uint64_t safe = oldestQuiescent();
+    uint32_t cur = current_.load(std::memory_order_relaxed) - versions_;
+
+    for (uint32_t i = 0; i < Versions; ++i)
+    {
+      if (i == cur || retiredAt_[i] > safe)
+        continue;
+
+      std::memcpy(versions_[i].data, data, sizeof(versions_[i].data));
+      current_.store(&versions_[i], std::memory_order_release);
+      retiredAt_[cur] = epoch_.fetch_add(1) + 1;
+
+      bump(publishes_);
+      return true;
+    }
+
+    bump(stalls_);
+    return false;
+  }
+
+  uint64_t publishes() const { return publishes_.load(std::memory_order_relaxed); }
+  uint64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+private:
+  static void bump(std::atomic<uint64_t>& c)
+  {
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  uint64_t oldestQuiescent() const
+  {
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    uint32_t readers = std::min(readers_.load(), MaxReaders);
+    for (uint32_t r = 0; r < readers; ++r)
+      oldest = std::min(oldest,
+          quiescent_[r].epoch.load(std::memory_order_acquire));
+    return oldest;
+  }
+
+  struct alignas(LineBytes) Version
+  {
+    uint32_t data[N]{};
+  };
+
+  struct alignas(LineBytes) Quiescent
+  {
+    std::atomic<uint64_t> epoch{0};
+  };
+
+  // read by every reader
+  alignas(LineBytes) std::atomic<Version*> current_{nullptr};
+  std::atomic<uint64_t> epoch_{0};
+
+  // the writer's
+  alignas(LineBytes) uint64_t retiredAt_[Versions]{};
+  std::atomic<uint64_t> publishes_{0};
+  std::atomic<uint64_t> stalls_{0};
+
+  alignas(LineBytes) std::atomic<uint32_t> readers_{0};
+  Version versions_[Versions];
+  Quiescent quiescent_[MaxReaders];
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// N words published by a single writer through a sequence lock.
+//
+// The writer makes the sequence odd, copies the data in and makes it
+// even again. Readers copy the whole block at once, memcpy so the
+// compiler can vectorize it, and retry when the sequence was odd or
+// moved during the copy. A torn copy is possible but always discarded,
+// the data itself is plain memory as in every seqlock.
+template <uint32_t N>
+class SeqLock
+{
+public:
+  static constexpr size_t LineBytes = 64;
+
+  void write(const uint32_t* v)
+  {
+    uint32_t s = seq_.load(std::memory_order_relaxed);
+    seq_.store(s + 1, std::memory_order_relaxed);
+    // the odd sequence is visible before any of the data
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(data_, v, sizeof(data_));
+    seq_.store(s + 2, std::memory_order_release);
+  }
+
+  // returns the number of retries
+  uint32_t read(uint32_t* out) const
+  {
+    uint32_t retries{0};
+    for (;;)
+    {
+      uint32_t s1 = seq_.load(std::memory_order_acquire);
+      if (!(s1 & 1))
+      {
+        std::memcpy(out, data_, sizeof(data_));
+        // the copy completes before the sequence is checked again
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) == s1)
+          return retries;
+      }
+      ++retries;
+      __builtin_ia32_pause();
+    }
+  }
+
+private:
+  alignas(LineBytes) std::atomic<uint32_t> seq_{0};
+  uint32_t data_[N]{};
+};
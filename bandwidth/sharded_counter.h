@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+// N counters sharded by writing thread. Each writer owns a cache line
+// aligned shard and updates it with relaxed load/store: no locked
+// instruction and no line written by two cores. Readers combine the
+// shards on demand, a read costs one line per writer.
+//
+// At most MaxShards writers, each claims its shard once.
+template <uint32_t N, uint32_t MaxShards>
+class ShardedCounters
+{
+public:
+  static constexpr size_t LineBytes = 64;
+
+  // Handle of one writer thread. Increments are batched in the writer's
+  // own memory and published to its shard every flushEvery commits,
+  // 1 publishes every commit.
+  class Writer
+  {
+  public:
+    Writer(ShardedCounters& c, uint32_t flushEvery)
+      : counters_(c)
+      , shard_(c.claim())
+      , flushEvery_(flushEvery)
+    {}
+
+    ~Writer() { flush(); }
+
+    void increment(uint32_t i) { ++pending_[i]; }
+
+    // end of one batch of increments
+    void commit()
+    {
+      if (++commits_ >= flushEvery_)
+        flush();
+    }
+
+    void flush()
+    {
+      for (uint32_t i = 0; i < N; ++i)
+      {
+        if (pending_[i])
+          counters_.add(shard_, i, pending_[i]);
+        pending_[i] = 0;
+      }
+      commits_ = 0;
+    }
+
+    ShardedCounters& counters() { return counters_; }
+
+  private:
+    ShardedCounters& counters_;
+    uint32_t shard_;
+    uint32_t flushEvery_;
+    uint32_t commits_{0};
+    uint64_t pending_[N]{};
+  };
+
+  uint32_t claim()
+  {
+    uint32_t s = claimed_.fetch_add(1, std::memory_order_relaxed);
+    if (s >= MaxShards)
+    {
+      // shards would have two writers
+      std::abort();
+    }
+    return s;
+  }
+
+  // single writer per shard
+  void add(uint32_t shard, uint32_t i, uint64_t v)
+  {
+    auto& c = shards_[shard].value[i];
+    c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+  }
+
+  // combined value of counter i
+  uint64_t read(uint32_t i) const
+  {
+    uint64_t sum{0};
+    uint32_t claimed = std::min(claimed_.load(std::memory_order_relaxed), MaxShards);
+    for (uint32_t s = 0; s < claimed; ++s)
+      sum += shards_[s].value[i].load(std::memory_order_relaxed);
+    return sum;
+  }
+
+private:
+  struct alignas(LineBytes) Shard
+  {
+    std::atomic<uint64_t> value[N]{};
+  };
+
+  alignas(LineBytes) std::atomic<uint32_t> claimed_{0};
+  Shard shards_[MaxShards];
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Bump allocator over a single mapping holding everything the roles of a
+// run share: queue, WorkData, trackers and run control.
+//
+// Private anonymous memory when the roles are threads. When they are forked
+// into processes it is a named POSIX shared memory segment mapped before the
+// fork, so every child sees the same objects at the same address.
+//
+// Each allocation starts on its own cache line so separate arrays never
+// share one, elements within an array keep the packing of their type.
+// Destructors run in reverse order when the arena goes away; only the
+// process that created the arena may destroy it.
+class SharedArena
+{
+public:
+  static constexpr size_t LineBytes = 64;
+
+  SharedArena(size_t bytes, bool shared)
+    : bytes_(bytes)
+  {
+    int fd = -1;
+    if (shared)
+    {
+      name_ = "/cl_testing." + std::to_string(getpid());
+      fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+      if (fd < 0 || ftruncate(fd, bytes_) != 0)
+      {
+        std::cerr << "Error creating shared memory segment "
+          << name_ << std::endl;
+        exit(0);
+      }
+    }
+
+    base_ = static_cast<char*>(mmap(nullptr, bytes_,
+          PROT_READ | PROT_WRITE,
+          shared ? MAP_SHARED : (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE),
+          fd, 0));
+
+    if (fd >= 0)
+      close(fd);
+
+    if (base_ == MAP_FAILED)
+    {
+      std::cerr << "Error mapping " << bytes_ << " bytes" << std::endl;
+      exit(0);
+    }
+  }
+
+  SharedArena(const SharedArena&) = delete;
+  SharedArena& operator=(const SharedArena&) = delete;
+
+  ~SharedArena()
+  {
+    for (auto i = destroy_.rbegin(); i != destroy_.rend(); ++i)
+      (*i)();
+
+    munmap(base_, bytes_);
+    unlink();
+  }
+
+  template <typename U, typename... Args>
+  U* make(Args&&... args)
+  {
+    U* u = new (allocate(sizeof(U), alignof(U))) U(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<U>::value)
+      destroy_.push_back([u] { u->~U(); });
+    return u;
+  }
+
+  // n default constructed elements
+  template <typename U>
+  U* makeArray(size_t n)
+  {
+    U* u = static_cast<U*>(allocate(sizeof(U) * n, alignof(U)));
+    for (size_t i = 0; i < n; ++i)
+      new (&u[i]) U();
+    if (!std::is_trivially_destructible<U>::value)
+      destroy_.push_back([u, n] { for (size_t i = 0; i < n; ++i) u[i].~U(); });
+    return u;
+  }
+
+  // the mapping stays valid, only the name goes
+  void unlink()
+  {
+    if (!name_.empty())
+      shm_unlink(name_.c_str());
+    name_.clear();
+  }
+
+  const std::string& name() const { return name_; }
+  size_t used() const { return used_; }
+
+private:
+  void* allocate(size_t size, size_t align)
+  {
+    align = std::max(align, LineBytes);
+    used_ = (used_ + align - 1) / align * align;
+    if (used_ + size > bytes_)
+    {
+      std::cerr << "Shared arena of " << bytes_
+        << " bytes exhausted" << std::endl;
+      exit(0);
+    }
+
+    void* p = base_ + used_;
+    used_ += size;
+    return p;
+  }
+
+  size_t bytes_;
+  size_t used_{0};
+  char* base_{nullptr};
+  std::string name_;
+  std::vector<std::function<void()>> destroy_;
+};
@@ -0,0 +1,220 @@
+//  zero-copy slab queue
+//
+//  Payloads live in a preallocated slab of cache line aligned slots and
+//  only 32 bit slot indices go through a gqueue. A producer claims a
+//  free slot, writes the message in place and pushes its index; the
+//  consumer pops the index, reads the message in place and releases the
+//  slot. Free slots are a tagged index stack, as cqueue's freelist.
+//
+//  push(T const &) and pop(U &) copy in and out of a slot for callers
+//  that want the usual queue interface.
+
+#ifndef BOOST_SLAB_QUEUE_HPP_INCLUDED
+#define BOOST_SLAB_QUEUE_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include <boost/assert.hpp>
+#include <boost/config.hpp> // for BOOST_LIKELY
+
+#include <boost/lockfree/detail/copy_payload.hpp>
+#include <boost/lockfree/detail/parameter.hpp>
+
+#include "boost_queue.hpp"
+#include "queue_hooks.h"
+
+namespace boost    {
+namespace lockfree {
+
+/** The queue class provides a multi-writer/multi-reader queue of
+ *  messages written and read in place in a fixed slab.
+ *
+ *  With boost::lockfree::capacity<> the slab and the index queue are
+ *  stored inside the queue object (so it can be placed in shared
+ *  memory), otherwise n slots are allocated by the constructor. A
+ *  claim, and so a push, fails when every slot is in use.
+ * */
+template <typename T, typename ...Options>
+class slabqueue
+{
+private:
+    typedef typename boost::parameter::parameters<boost::parameter::optional<tag::allocator>,
+                                                  boost::parameter::optional<tag::capacity>
+                                                 >::template bind<Options...>::type bound_args;
+
+    static const bool has_capacity = detail::extract_capacity<bound_args>::has_capacity;
+    static const size_t capacity = detail::extract_capacity<bound_args>::capacity;
+
+    typedef std::uint64_t tagged_index;
+    typedef ::bandwidth::QueueCounters counters;
+    typedef gqueue<std::uint32_t, Options...> index_queue;
+
+    static std::uint32_t index(tagged_index t) { return static_cast<std::uint32_t>(t); }
+    static std::uint32_t tag(tagged_index t) { return static_cast<std::uint32_t>(t >> 32); }
+    static tagged_index make(std::uint32_t i, std::uint32_t t)
+    {
+        return (static_cast<tagged_index>(t) << 32) | i;
+    }
+
+    struct BOOST_ALIGNMENT(64) slot
+    {
+        T data;
+        // freelist link while the slot is free
+        std::atomic<std::uint32_t> next;
+    };
+
+    struct inline_slots
+    {
+        inline_slots(size_t) {}
+        slot * get() { return slots; }
+        slot slots[capacity];
+    };
+
+    struct allocated_slots
+    {
+        allocated_slots(size_t n) : slots(new slot[n]) {}
+        slot * get() { return slots.get(); }
+        std::unique_ptr<slot[]> slots;
+    };
+
+    typedef typename std::conditional<has_capacity, inline_slots, allocated_slots>::type storage;
+
+    BOOST_DELETED_FUNCTION(slabqueue(slabqueue const&))
+    BOOST_DELETED_FUNCTION(slabqueue& operator= (slabqueue const&))
+
+public:
+    typedef T value_type;
+
+    static const std::uint32_t null_slot = 0xffffffff;
+
+    // a slab slot and the index queue's node it is passed in
+    static const size_t node_bytes = sizeof(slot) + index_queue::node_bytes;
+
+    //! Construct queue with capacity<> slots
+    slabqueue(void):
+        slot_count(capacity),
+        storage_(capacity)
+    {
+        initialize();
+    }
+
+    //! Construct queue, allocate n slots
+    explicit slabqueue(size_t n):
+        indices_(n),
+        slot_count(n),
+        storage_(n)
+    {
+        initialize();
+    }
+
+    //! A free slot to write a message in, null_slot if there is none
+    std::uint32_t claim(void)
+    {
+        for (;;) {
+            tagged_index f = free_.load(std::memory_order_acquire);
+            if (index(f) == null_slot) {
+                ::bandwidth::count(counters::FailedPushes);
+                return null_slot;
+            }
+
+            std::uint32_t next = at_slot(index(f)).next.load(std::memory_order_relaxed);
+            ::bandwidth::tagWrite("queue freelist", &free_, sizeof(free_));
+            if (::bandwidth::countCas(counters::FreelistCas,
+                        free_.compare_exchange_weak(f, make(next, tag(f) + 1))))
+                return index(f);
+        }
+    }
+
+    T & at(std::uint32_t s) { return at_slot(s).data; }
+
+    //! Calls f(begin, bytes) for the slots and the index queue's nodes
+    //! allocated outside the queue object
+    template <typename F>
+    void for_each_node_block(F && f)
+    {
+        if (!has_capacity)
+            f(storage_.get(), slot_count * sizeof(slot));
+        indices_.for_each_node_block(f);
+    }
+
+    //! Queues a claimed slot, its message written
+    void push_slot(std::uint32_t s)
+    {
+        // the index queue holds every slot, it cannot be full
+        while (!indices_.push(s))
+            ;
+    }
+
+    bool pop_slot(std::uint32_t & s)
+    {
+        return indices_.pop(s);
+    }
+
+    //! The popped slot's message is no longer read
+    void release(std::uint32_t s)
+    {
+        slot & ss = at_slot(s);
+        for (;;) {
+            tagged_index f = free_.load(std::memory_order_acquire);
+            ::bandwidth::tagWrite("queue slot", &ss.next, sizeof(ss.next));
+            ss.next.store(index(f), std::memory_order_relaxed);
+
+            ::bandwidth::tagWrite("queue freelist", &free_, sizeof(free_));
+            if (::bandwidth::countCas(counters::FreelistCas,
+                        free_.compare_exchange_weak(f, make(s, tag(f) + 1))))
+                return;
+        }
+    }
+
+    bool push(T const & t)
+    {
+        std::uint32_t s = claim();
+        if (s == null_slot)
+            return false;
+
+        ::bandwidth::tagWrite("queue slot", &at(s), sizeof(T));
+        at(s) = t;
+        push_slot(s);
+        return true;
+    }
+
+    template <typename U>
+    bool pop(U & ret)
+    {
+        std::uint32_t s;
+        if (!pop_slot(s))
+            return false;
+
+        detail::copy_payload(at(s), ret);
+        release(s);
+        return true;
+    }
+
+private:
+    slot & at_slot(std::uint32_t s) { return storage_.get()[s]; }
+
+    void initialize(void)
+    {
+        BOOST_ASSERT(slot_count < null_slot);
+
+        for (std::uint32_t s = 0; s < slot_count; ++s)
+            at_slot(s).next.store(s + 1 < slot_count ? s + 1 : null_slot,
+                    std::memory_order_relaxed);
+        free_.store(make(slot_count ? 0 : null_slot, 0), std::memory_order_release);
+    }
+
+    index_queue indices_;
+
+    alignas(64) std::atomic<tagged_index> free_;
+    size_t slot_count;
+
+    alignas(64) storage storage_;
+};
+
+} /* namespace lockfree */
+} /* namespace boost */
+
+#endif /* BOOST_SLAB_QUEUE_HPP_INCLUDED */